@@ -1,13 +1,17 @@
 import datetime
+import logging
 from itertools import groupby
 
 import esphome.config_validation as cv
+import esphome.final_validate as fv
 import esphome.codegen as cg
 from esphome import automation
 from esphome.const import CONF_ID, CONF_TRIGGER_ID
 from esphome.components.canbus import CanbusComponent
 from esphome.core import CORE
 
+_LOGGER = logging.getLogger(__name__)
+
 ns = cg.esphome_ns.namespace("canopen")
 
 TPDO = ns.struct("TPDO")
@@ -34,6 +38,7 @@ CmdTriggerInt32 = ns.class_("CmdTriggerInt32", automation.Trigger.template())
 CONF_ENTITIES = "entities"
 
 DEPENDENCIES = []
+AUTO_LOAD = ["canbus"]
 
 CSDO_SCHEMA = cv.Schema(
     {
@@ -54,21 +59,82 @@ RPDO_SCHEMA = cv.Schema(
 
 TPDO_SCHEMA = cv.Schema(
     {
-        cv.Required("number"): cv.int_,
+        cv.Required("number"): cv.Any(cv.int_, cv.one_of("auto")),
         cv.Optional("is_async", default=True): cv.boolean,
+        cv.Optional("sync"): cv.int_range(min=1, max=240),
+        cv.Optional("inhibit_time"): cv.All(
+            cv.positive_time_period_microseconds,
+            cv.Range(max=cv.TimePeriod(microseconds=6553500)),
+        ),
+        cv.Optional("event_timer"): cv.All(
+            cv.positive_time_period_milliseconds,
+            cv.Range(max=cv.TimePeriod(milliseconds=65535)),
+        ),
     }
 )
 
-ENTITY_SCHEMA = cv.Schema(
-    {
-        cv.Required("id"): cv.use_id(cg.EntityBase),
-        cv.Required("index"): cv.int_,
-        cv.Optional("size"): cv.int_,
-        cv.Optional("min_value"): cv.float_,
-        cv.Optional("max_value"): cv.float_,
-        cv.Optional("tpdo"): cv.Any(cv.int_, TPDO_SCHEMA),
-        cv.Optional("rpdo"): cv.ensure_list(RPDO_SCHEMA),
-    }
+def validate_deadband(value):
+    if isinstance(value, str) and value.strip().endswith("%"):
+        return {"percent": cv.positive_float(value.strip()[:-1])}
+    return {"absolute": cv.positive_float(value)}
+
+
+def validate_entity_deadband(config):
+    deadband = config.get("deadband")
+    if deadband and "percent" in deadband and config.get("size") not in (1, 2):
+        if "min_value" not in config or "max_value" not in config:
+            raise cv.Invalid(
+                "deadband in percent requires min_value and max_value "
+                "for 4-byte entities"
+            )
+    return config
+
+
+# entity domains with deadband / only_on_change support (see add_entity overloads)
+DEADBAND_DOMAINS = ("sensor", "number")
+
+
+def final_validate_entity_deadband(config):
+    full_config = fv.full_config.get()
+    for n, node_config in enumerate(config):
+        for i, entity_config in enumerate(node_config[CONF_ENTITIES]):
+            if "deadband" not in entity_config and not entity_config["only_on_change"]:
+                continue
+            # path of the declaring component, e.g. ["sensor", 0, "id"]
+            path = full_config.get_path_for_id(entity_config["id"])
+            if path and path[0] in DEADBAND_DOMAINS:
+                continue
+            key = "deadband" if "deadband" in entity_config else "only_on_change"
+            raise cv.Invalid(
+                f"{key} is supported only by sensor and number entities",
+                path=[n, CONF_ENTITIES, i, key],
+            )
+
+
+def entity_value_range(entity_config):
+    size = entity_config.get("size")
+    min_val = entity_config.get("min_value", 0)
+    default_max = 0 if size not in (1, 2) else (254 if size == 1 else 65534)
+    # 255 / 65535 reserved for NaN
+    return min_val, entity_config.get("max_value", default_max)
+
+
+ENTITY_SCHEMA = cv.All(
+    cv.Schema(
+        {
+            cv.Required("id"): cv.use_id(cg.EntityBase),
+            cv.Required("index"): cv.int_,
+            cv.Optional("size"): cv.int_,
+            cv.Optional("min_value"): cv.float_,
+            cv.Optional("max_value"): cv.float_,
+            cv.Optional("tpdo"): cv.Any(cv.int_, cv.one_of("auto"), TPDO_SCHEMA),
+            cv.Optional("rpdo"): cv.ensure_list(RPDO_SCHEMA),
+            cv.Optional("deadband"): validate_deadband,
+            cv.Optional("only_on_change", default=False): cv.boolean,
+            cv.Optional("groups"): cv.ensure_list(cv.int_range(min=1, max=255)),
+        }
+    ),
+    validate_entity_deadband,
 )
 
 
@@ -120,6 +186,114 @@ TEMPLATE_ENTITY = cv.Schema(
     }
 )
 
+def validate_power_of_two(value):
+    value = cv.int_range(min=1, max=1024)(value)
+    if value & (value - 1):
+        raise cv.Invalid(f"{value} is not a power of two")
+    return value
+
+
+TPDO_SHARED_SETTINGS = ("sync", "inhibit_time", "event_timer")
+
+
+def validate_tpdo_settings(config):
+    settings_by_tpdo = {}
+    for entity in config[CONF_ENTITIES]:
+        tpdo = entity.get("tpdo")
+        if not isinstance(tpdo, dict):
+            continue
+        if "sync" in tpdo and ("inhibit_time" in tpdo or "event_timer" in tpdo):
+            raise cv.Invalid(
+                f"TPDO {tpdo['number']}: "
+                "inhibit_time / event_timer can't be used with sync"
+            )
+        if tpdo["number"] == "auto":
+            continue
+        settings = tuple(tpdo.get(key) for key in TPDO_SHARED_SETTINGS)
+        if settings_by_tpdo.setdefault(tpdo["number"], settings) != settings:
+            raise cv.Invalid(
+                f"TPDO {tpdo['number']}: all entities must use the same "
+                f"{', '.join(TPDO_SHARED_SETTINGS)} settings"
+            )
+    return config
+
+
+# TPDO 7 would be sent on OD writer COB-ID (0x500 + node_id), nodes with OD writer
+# enabled would interpret its payload as (broadcast) commands
+OD_WRITER_TPDO = 7
+
+
+def validate_od_writer(config):
+    for entity in config[CONF_ENTITIES] + config.get("template_entities", []):
+        tpdo = entity.get("tpdo", -1)
+        number = tpdo["number"] if isinstance(tpdo, dict) else tpdo
+        if number == OD_WRITER_TPDO:
+            raise cv.Invalid(
+                f"entity {entity['index']}: TPDO {OD_WRITER_TPDO} shares COB-ID "
+                f"0x{0x500 + config['node_id']:03x} with OD writer frames"
+            )
+    if "od_writer_senders" in config and not config["pdo_od_writer"]:
+        raise cv.Invalid("od_writer_senders requires pdo_od_writer")
+    return config
+
+
+def tpdo_cob_id(node_id, number):
+    # TPDO 4..7 use default COB-IDs of RPDO 0..3
+    return 0x180 + 0x100 * (number % 4) + (0x80 if number >= 4 else 0) + node_id
+
+
+def node_cob_ids(config):
+    """COB-IDs sent or consumed by the node, with their purpose"""
+    node_id = config["node_id"]
+    ids = {
+        0x000: "NMT",
+        0x080: "SYNC",
+        0x580 + node_id: "SDO response",
+        0x600 + node_id: "SDO request",
+        0x700 + node_id: "heartbeat",
+    }
+    for number in range(8):
+        ids.setdefault(tpdo_cob_id(node_id, number), f"TPDO {number}")
+    if config["pdo_od_writer"]:
+        for sender in range(1, 128):
+            ids.setdefault(0x500 + sender, "OD writer")
+    for client in config.get("heartbeat_clients", ()):
+        ids.setdefault(0x700 + client["node_id"], "heartbeat consumer")
+    for entity in config[CONF_ENTITIES]:
+        for rpdo in entity.get("rpdo", ()):
+            ids.setdefault(
+                tpdo_cob_id(rpdo["node_id"], rpdo["tpdo"]),
+                f"RPDO of entity {entity['index']}",
+            )
+    return ids
+
+
+GROUP_N = 8  # CANOPEN_GROUP_N
+
+
+def validate_groups(config):
+    entries = len(config.get("groups", ())) + sum(
+        len(entity.get("groups", ())) for entity in config[CONF_ENTITIES]
+    )
+    if entries > GROUP_N:
+        raise cv.Invalid(f"at most {GROUP_N} group memberships are supported")
+    return config
+
+
+def validate_virtual_bus(config):
+    if config["virtual_bus"]:
+        config.pop("canbus_id", None)
+    return config
+
+
+SDO_CLIENT_SCHEMA = cv.Schema(
+    {
+        cv.Optional("channels", 1): cv.int_range(min=1, max=16),
+        cv.Optional("timeout", "1000ms"): cv.positive_time_period_milliseconds,
+        cv.Optional("retries", 0): cv.int_range(min=0, max=255),
+    }
+)
+
 HB_CLIENT_SCHEMA = cv.Schema(
     {
         cv.Required("node_id"): cv.All(cv.int_, cv.Range(min=0, max=127)),
@@ -128,49 +302,94 @@ HB_CLIENT_SCHEMA = cv.Schema(
 )
 
 CONFIG_SCHEMA = cv.ensure_list(
-    cv.Schema(
-        {
-            cv.GenerateID(): cv.declare_id(CanopenComponent),
-            cv.GenerateID("canbus_id"): cv.use_id(CanbusComponent),
-            # cv.GenerateID("ota_id"): cv.use_id(CanopenOTAComponent),
-            cv.Required("node_id"): cv.All(cv.int_, cv.Range(min=0, max=127)),
-            # cv.Optional("status"): STATUS_ENTITY_SCHEMA,
-            cv.Optional("csdo"): cv.ensure_list(CSDO_SCHEMA),
-            cv.Required(CONF_ENTITIES): cv.ensure_list(ENTITY_SCHEMA),
-            cv.Optional("sdo_block_transfer_size", 63): cv.All(
-                cv.int_, cv.Range(min=1, max=127)
-            ),
-            cv.Optional("template_entities"): cv.ensure_list(TEMPLATE_ENTITY),
-            cv.Optional("on_pre_operational"): automation.validate_automation(
-                {
-                    cv.GenerateID(CONF_TRIGGER_ID): cv.declare_id(
-                        PreOperationalTrigger
-                    ),
-                }
-            ),
-            cv.Optional("on_operational"): automation.validate_automation(
-                {
-                    cv.GenerateID(CONF_TRIGGER_ID): cv.declare_id(OperationalTrigger),
-                }
-            ),
-            cv.Optional("on_hb_consumer_event"): automation.validate_automation(
-                {
-                    cv.GenerateID(CONF_TRIGGER_ID): cv.declare_id(
-                        HbConsumerEventTrigger
-                    ),
-                }
-            ),
-            cv.Optional("pdo_od_writer", default=True): cv.boolean,
-            cv.Optional(
-                "heartbeat_interval", "5000ms"
-            ): cv.positive_time_period_milliseconds,
-            cv.Optional("heartbeat_clients"): cv.ensure_list(HB_CLIENT_SCHEMA),
-            cv.Optional("sw_version"): cv.string,
-            cv.Optional("hw_version"): cv.string,
-        }
-    ).extend(cv.COMPONENT_SCHEMA)
+    cv.All(
+        cv.Schema(
+            {
+                cv.GenerateID(): cv.declare_id(CanopenComponent),
+                cv.GenerateID("canbus_id"): cv.use_id(CanbusComponent),
+                cv.Optional("virtual_bus", default=False): cv.boolean,
+                # cv.GenerateID("ota_id"): cv.use_id(CanopenOTAComponent),
+                cv.Required("node_id"): cv.All(cv.int_, cv.Range(min=0, max=127)),
+                # cv.Optional("status"): STATUS_ENTITY_SCHEMA,
+                cv.Optional("csdo"): cv.ensure_list(CSDO_SCHEMA),
+                cv.Optional("sdo_client"): SDO_CLIENT_SCHEMA,
+                cv.Optional("discovery", default=False): cv.boolean,
+                cv.Optional("compact_metadata", default=False): cv.boolean,
+                cv.Required(CONF_ENTITIES): cv.ensure_list(ENTITY_SCHEMA),
+                cv.Optional("sdo_block_transfer_size", 63): cv.All(
+                    cv.int_, cv.Range(min=1, max=127)
+                ),
+                cv.Optional("rx_queue_len", 32): validate_power_of_two,
+                cv.Optional("template_entities"): cv.ensure_list(TEMPLATE_ENTITY),
+                cv.Optional("on_pre_operational"): automation.validate_automation(
+                    {
+                        cv.GenerateID(CONF_TRIGGER_ID): cv.declare_id(
+                            PreOperationalTrigger
+                        ),
+                    }
+                ),
+                cv.Optional("on_operational"): automation.validate_automation(
+                    {
+                        cv.GenerateID(CONF_TRIGGER_ID): cv.declare_id(OperationalTrigger),
+                    }
+                ),
+                cv.Optional("on_hb_consumer_event"): automation.validate_automation(
+                    {
+                        cv.GenerateID(CONF_TRIGGER_ID): cv.declare_id(
+                            HbConsumerEventTrigger
+                        ),
+                    }
+                ),
+                cv.Optional("pdo_od_writer", default=True): cv.boolean,
+                cv.Optional("od_writer_senders"): cv.ensure_list(
+                    cv.int_range(min=1, max=127)
+                ),
+                cv.Optional(
+                    "heartbeat_interval", "5000ms"
+                ): cv.positive_time_period_milliseconds,
+                cv.Optional("heartbeat_clients"): cv.ensure_list(HB_CLIENT_SCHEMA),
+                cv.Optional("sync_producer"): cv.positive_time_period_milliseconds,
+                cv.Optional("groups"): cv.ensure_list(cv.int_range(min=1, max=255)),
+                cv.Optional("sw_version"): cv.string,
+                cv.Optional("hw_version"): cv.string,
+            }
+        ).extend(cv.COMPONENT_SCHEMA),
+        validate_virtual_bus,
+        validate_tpdo_settings,
+        validate_od_writer,
+        validate_groups,
+    )
 )
 
+
+def declared_type(full_config, id_):
+    # type of ID declared by the entity component, e.g. esphome::sensor::Sensor subclass
+    path = full_config.get_path_for_id(id_)
+    return full_config.get_config_for_path(path[:-1])[CONF_ID].type
+
+
+def final_validate_tpdos(config):
+    full_config = fv.full_config.get()
+    for n, node_config in enumerate(config):
+        entity_sizes = tpdo_entity_sizes(
+            node_config, lambda e: declared_type(full_config, e["id"])
+        )
+        try:
+            allocate_tpdos(
+                node_config["node_id"], tpdo_entities(node_config), entity_sizes, False
+            )
+        except cv.Invalid as err:
+            err.prepend([n, CONF_ENTITIES])
+            raise
+
+
+def final_validate(config):
+    final_validate_entity_deadband(config)
+    final_validate_tpdos(config)
+
+
+FINAL_VALIDATE_SCHEMA = final_validate
+
 TYPE_TO_CANOPEN_TYPE = {
     "uint8": (cg.RawExpression("CO_TUNSIGNED8"), 1),
     "uint16": (cg.RawExpression("CO_TUNSIGNED16"), 2),
@@ -181,23 +400,178 @@ TYPE_TO_CANOPEN_TYPE = {
 }
 
 
+# (min, max) number of bytes mapped to TPDO by entity type, unless `size` is given
+ENTITY_STATE_SIZES = {
+    "esphome::sensor::Sensor": (4, 4),
+    "esphome::number::Number": (4, 4),
+    "esphome::binary_sensor::BinarySensor": (1, 1),
+    "esphome::switch_::Switch": (1, 1),
+    "esphome::light::LightState": (1, 3),  # state, brightness, color temperature
+    "esphome::cover::Cover": (1, 3),  # state, position, tilt
+    "esphome::alarm_control_panel::AlarmControlPanel": (1, 1),
+}
+
+
+def entity_state_sizes(entity_type, entity_config):
+    if "size" in entity_config:
+        return entity_config["size"], entity_config["size"]
+    types = [entity_type]
+    while types:
+        type_ = types.pop()
+        if str(type_) in ENTITY_STATE_SIZES:
+            return ENTITY_STATE_SIZES[str(type_)]
+        types.extend(getattr(type_, "_parents", ()))
+    return 4, 4
+
+
+def tpdo_entities(config):
+    entities = sorted(config[CONF_ENTITIES], key=lambda x: x["index"])
+    return entities + list(config.get("template_entities", []))
+
+
+def tpdo_entity_sizes(config, entity_type):
+    """(min, max) number of TPDO bytes by entity / template entity index,
+    entity_type returns C++ type of given entity config"""
+    entity_sizes = {}
+    for entity_config in config[CONF_ENTITIES]:
+        entity_sizes[entity_config["index"]] = entity_state_sizes(
+            entity_type(entity_config), entity_config
+        )
+    for tmpl_entity in config.get("template_entities", []):
+        size = sum(
+            TYPE_TO_CANOPEN_TYPE[state["type"]][1]
+            for state in tmpl_entity.get("states", ())
+        )
+        entity_sizes[tmpl_entity["index"]] = (size, size)
+    return entity_sizes
+
+
+def tpdo_update_class(tpdo):
+    return tuple(tpdo.get(key) for key in ("is_async", *TPDO_SHARED_SETTINGS))
+
+
+def auto_tpdo(entity):
+    tpdo = entity["tpdo"]
+    return tpdo if isinstance(tpdo, dict) else {"number": tpdo, "is_async": False}
+
+
+def allocate_tpdos(node_id, entities, entity_sizes, log=True):
+    """Checks TPDO size limits and packs `tpdo: auto` entities into free TPDOs,
+    returns tpdo config for each auto-mapped entity index; errors are raised
+    as cv.Invalid (reported by final validation, before code generation)"""
+    used = {}
+    auto = []
+    for entity in entities:
+        tpdo = entity.get("tpdo", -1)
+        number = tpdo["number"] if isinstance(tpdo, dict) else tpdo
+        if number == "auto":
+            auto.append(entity)
+        elif number >= 0:
+            used.setdefault(number, []).append(entity["index"])
+
+    for number, indices in sorted(used.items()):
+        min_size = sum(entity_sizes[index][0] for index in indices)
+        max_size = sum(entity_sizes[index][1] for index in indices)
+        if min_size > 8:
+            raise cv.Invalid(
+                f"canopen node {node_id}: TPDO {number} exceeds 8 bytes "
+                f"(entities {indices}, {min_size} bytes)"
+            )
+        if max_size > 8 and log:
+            _LOGGER.warning(
+                "canopen node %d: TPDO %d may exceed 8 bytes, depending on "
+                "entity traits (entities %s, up to %d bytes)",
+                node_id,
+                number,
+                indices,
+                max_size,
+            )
+
+    free = [n for n in range(8) if n not in used and n != OD_WRITER_TPDO]
+    # first fit decreasing, separately for each update class
+    auto.sort(
+        key=lambda e: (
+            str(tpdo_update_class(auto_tpdo(e))),
+            -entity_sizes[e["index"]][1],
+        )
+    )
+
+    assigned = {}
+    pdos = []  # [number, update class, free bytes, entity indices]
+    for entity in auto:
+        index = entity["index"]
+        size = entity_sizes[index][1]
+        update_class = tpdo_update_class(auto_tpdo(entity))
+        pdo = next(
+            (p for p in pdos if p[1] == update_class and p[2] >= size),
+            None,
+        )
+        if pdo is None:
+            if not free:
+                raise cv.Invalid(
+                    f"canopen node {node_id}: no free TPDO left for entity {index}"
+                )
+            pdo = [free.pop(0), update_class, 8, []]
+            pdos.append(pdo)
+        pdo[2] -= size
+        pdo[3].append(index)
+        assigned[index] = {**auto_tpdo(entity), "number": pdo[0]}
+
+    if log:
+        for number, _, free_bytes, indices in pdos:
+            _LOGGER.info(
+                "canopen node %d: TPDO %d <- entities %s (%d/8 bytes)",
+                node_id,
+                number,
+                indices,
+                8 - free_bytes,
+            )
+    return assigned
+
+
 def to_code(config_list):
     if not getattr(CORE, "is_stm32", False):
         extra_build_flags = ("-DOTA_COMPRESSION=1", )
     else:
         extra_build_flags = ()
 
+    # name, device_class, unit and state_class for each entity (unless exposed only in
+    # descriptor) + device name / hw / sw version strings
+    od_str_n = max(
+        (
+            0
+            if config["compact_metadata"]
+            else 4 * (len(config[CONF_ENTITIES]) + len(config.get("template_entities", ())))
+        )
+        + 4
+        for config in config_list
+    )
+    extra_build_flags += (f"-DCANOPEN_OD_STR_N={od_str_n}",)
+
+    # SDO client channels, shared by `csdo` and `sdo_client` requests
+    csdo_n = max(
+        max(
+            len(config.get("csdo", ())),
+            config.get("sdo_client", {}).get("channels", 0),
+            1 if config["discovery"] else 0,
+        )
+        for config in config_list
+    )
+    extra_build_flags += (
+        f"-DCO_CSDO_N={max(csdo_n, 1)}",
+        f"-DUSE_CSDO={1 if csdo_n else 0}",
+    )
+
     for config in config_list:
         cg.add_platformio_option(
             "build_flags",
             [
                 "-DCO_SDO_BUF_SEG={}".format(config["sdo_block_transfer_size"]),
+                "-DCANOPEN_RX_QUEUE_LEN={}".format(config["rx_queue_len"]),
                 "-DCO_SSDO_N=1",
-                "-DCO_CSDO_N=1",
                 "-DCO_RPDO_N=4",
                 "-DCO_TPDO_N=8",
                 "-DUSE_LSS=0",
-                "-DUSE_CSDO=0",
                 "-DMINIZ_NO_STDIO=1",
                 *extra_build_flags,
             ],
@@ -208,11 +582,21 @@ def to_code(config_list):
         node_id = config["node_id"]
         canopen = cg.new_Pvariable(config[CONF_ID], node_id)
 
-        canbus = yield cg.get_variable(config["canbus_id"])
-        cg.add(canopen.set_canbus(canbus))
+        if "canbus_id" in config:
+            canbus = yield cg.get_variable(config["canbus_id"])
+            cg.add(canopen.set_canbus(canbus))
 
         cg.add(canopen.set_heartbeat_interval(config["heartbeat_interval"]))
         cg.add(canopen.enable_pdo_od_writer(config["pdo_od_writer"]))
+        if "od_writer_senders" in config:
+            cg.add(canopen.set_od_writer_senders(config["od_writer_senders"]))
+        # must precede od_add_metadata() calls
+        if config["compact_metadata"]:
+            cg.add(canopen.set_compact_metadata(True))
+        if "sync_producer" in config:
+            cg.add(canopen.set_sync_producer(config["sync_producer"]))
+        for group in config.get("groups", ()):
+            cg.add(canopen.add_group(group))
         hw_version = config.get("hw_version")
         sw_version = config.get("sw_version")
 
@@ -227,9 +611,11 @@ def to_code(config_list):
         sw_version = f"version_str_{node_id} + 18"
 
         if hw_version:
-            cg.add(canopen.od_set_string(0x1009, 0, hw_version))
+            cg.add(canopen.od_set_static_string(0x1009, 0, hw_version))
         if sw_version:
-            cg.add(canopen.od_set_string(0x100A, 0, cg.RawExpression(sw_version)))
+            cg.add(
+                canopen.od_set_static_string(0x100A, 0, cg.RawExpression(sw_version))
+            )
 
         yield cg.register_component(canopen, config)
 
@@ -237,34 +623,70 @@ def to_code(config_list):
         assert len(entities) == len(
             set(e["index"] for e in entities)
         ), "All entity indices must be unique!"
+
+        entity_types = {}
+        for entity_config in entities:
+            entity = yield cg.get_variable(entity_config["id"])
+            entity_types[entity_config["index"]] = entity.base.type
+        entity_sizes = tpdo_entity_sizes(config, lambda e: entity_types[e["index"]])
+        # already validated by final_validate_tpdos()
+        auto_tpdos = allocate_tpdos(node_id, tpdo_entities(config), entity_sizes)
+
         for entity_config in entities:
             entity = yield cg.get_variable(entity_config["id"])
-            tpdo = entity_config.get("tpdo", -1)
+            tpdo = auto_tpdos.get(
+                entity_config["index"], entity_config.get("tpdo", -1)
+            )
             if not isinstance(tpdo, dict):
                 tpdo = {"number": tpdo, "is_async": False}
 
+            sync = tpdo.get("sync", 0)
+            # inhibit time (in 100us units) and event timer go to 0x1800+N:03 / :05,
+            # changes of such TPDOs are flushed once per loop()
+            inhibit_time = (
+                tpdo["inhibit_time"].total_microseconds // 100
+                if "inhibit_time" in tpdo
+                else 0
+            )
+            event_timer = (
+                tpdo["event_timer"].total_milliseconds if "event_timer" in tpdo else 0
+            )
+            is_async = tpdo["is_async"] and not (sync or inhibit_time or event_timer)
             tpdo_struct = cg.StructInitializer(
-                TPDO, ("number", tpdo["number"]), ("is_async", tpdo["is_async"])
+                TPDO,
+                ("number", tpdo["number"]),
+                ("is_async", is_async),
+                ("sync", sync),
+                ("inhibit_time", inhibit_time),
+                ("event_timer", event_timer),
             )
 
             size = entity_config.get("size")
+            args = []
             if size in (1, 2):
-                min_val = entity_config.get("min_value", 0)
-                max_val = entity_config.get(
-                    "max_value", 254 if size == 1 else 65534
-                )  # 255 / 65535 reserved for NaN
-                cg.add(
-                    canopen.add_entity(
-                        entity,
-                        entity_config["index"],
-                        tpdo_struct,
-                        size,
-                        min_val,
-                        max_val,
-                    )
-                )
-            else:
-                cg.add(canopen.add_entity(entity, entity_config["index"], tpdo_struct))
+                min_val, max_val = entity_value_range(entity_config)
+                args = [size, min_val, max_val]
+
+            # deadband / only_on_change are validated for sensor / number entities only
+            deadband = entity_config.get("deadband")
+            only_on_change = entity_config["only_on_change"]
+            if deadband or only_on_change:
+                if not args:
+                    args = [4, 0, 0]
+                if not deadband:
+                    deadband_abs = 0
+                elif "percent" in deadband:
+                    min_val, max_val = entity_value_range(entity_config)
+                    deadband_abs = deadband["percent"] / 100 * (max_val - min_val)
+                else:
+                    deadband_abs = deadband["absolute"]
+                args += [deadband_abs, only_on_change]
+
+            cg.add(
+                canopen.add_entity(entity, entity_config["index"], tpdo_struct, *args)
+            )
+            for group in entity_config.get("groups", ()):
+                cg.add(canopen.add_group(group, entity_config["index"]))
 
         for tmpl_entity in config.get("template_entities", []):
             index = tmpl_entity["index"]
@@ -300,6 +722,15 @@ def to_code(config_list):
                         )
                     )
 
+        if "sdo_client" in config:
+            sdo_client = config["sdo_client"]
+            cg.add(
+                canopen.set_sdo_client_defaults(
+                    sdo_client["timeout"], sdo_client["retries"]
+                )
+            )
+        if config["discovery"]:
+            cg.add(canopen.set_discovery(True))
         for num, csdo in enumerate(config.get("csdo", ())):
             cg.add(
                 canopen.setup_csdo(num, csdo["node_id"], csdo["tx_id"], csdo["rx_id"])
@@ -1,6 +1,7 @@
 #include <map>
 #ifdef USE_ESP32
 #include <driver/twai.h>
+#include <esp_system.h>
 #endif
 #include "esphome.h"
 #include "canopen.h"
@@ -50,16 +51,18 @@ CanopenComponent *current_canopen = 0;
 // use last RPDO for od_writer
 const uint32_t OD_WRITER_COB_ID_BASE = CO_COBID_RPDO_DEFAULT(3);
 
-CO_OBJ_STR *od_string(const std::string &str) {
-  auto od_str = new CO_OBJ_STR();
-  od_str->Offset = 0;
-  od_str->Start = (uint8_t *) (new std::string(str))->c_str();
-  return od_str;
-}
+const uint32_t NMT_COB_ID = 0x000;
+const uint32_t SYNC_COB_ID = 0x080;
+const uint32_t HEARTBEAT_COB_ID_BASE = 0x700;
+const uint32_t PDO_COB_ID_INVALID = 1ul << 31;
+
+const char *od_copy_string(const std::string &str) { return (new std::string(str))->c_str(); }
 
 void BaseCanopenEntity::od_set_state(CanopenComponent *canopen, uint32_t key, void *state, uint8_t size) {
   canopen->od_set_state(key, state, size);
-  if (!tpdo.is_async) {
+  if (tpdo.number >= 0)
+    canopen->tpdo_state_changed(tpdo.number);
+  if (!tpdo.is_async && !tpdo.sync) {
     canopen->dirty_tpdo_mask |= (1 << tpdo.number);
   }
 }
@@ -124,13 +127,21 @@ const struct CO_OBJ_T od_header[] = {
     {CO_KEY(0x1200, 2, CO_OBJ__N__R_), CO_TUNSIGNED32, (CO_DATA) (&Obj1200_02_20)},
 };
 
+CO_OBJ_STR *CanopenComponent::od_string(const char *str) {
+  if (od_strings.size() < od_strings.capacity()) {
+    od_strings.push_back({0, (uint8_t *) str});
+    return &od_strings.back();
+  }
+  return new CO_OBJ_STR{0, (uint8_t *) str};
+}
+
 CanopenComponent::CanopenComponent(uint32_t node_id) : od(APP_OBJ_N), hfq_requester() {
   ESP_LOGI(TAG, "initializing CANopen-stack, node_id: %03lx", node_id);
   canopen_node.canopen = this;
   node = &canopen_node.node;
 
-  recv_frames.reserve(3);
-
+  tx_data.reserve(sizeof(CO_IF_FRM::Data));
+  od_strings.reserve(CANOPEN_OD_STR_N);
   memset(rpdo_buf, 0, sizeof(rpdo_buf));
   this->node_id = node_id;
 
@@ -158,21 +169,115 @@ CanopenComponent::CanopenComponent(uint32_t node_id) : od(APP_OBJ_N), hfq_reques
   };
 
   for (int i = 0; i < 8; i++)
-    od.append(CO_KEY(0x1800 + i, 0, CO_OBJ_D___R_), CO_TUNSIGNED8, 0);
+    od.append(CO_KEY(0x1800 + i, 0, CO_OBJ_D___R_), CO_TUNSIGNED8, 5);
   for (int i = 0; i < 8; i++)
     od.append(CO_KEY(0x1A00 + i, 0, CO_OBJ_D___R_), CO_TUNSIGNED8, 0);
 
   od.append(CO_KEY(0x2000, 0, CO_OBJ_D___R_), CO_TUNSIGNED8, 0);
 
+  od.append(CO_KEY(0x3100, 0, CO_OBJ_D___R_), CO_TUNSIGNED8, 6);
+  od.append(CO_KEY(0x3100, 1, CO_OBJ_____R_), CO_TUNSIGNED32, (CO_DATA) &bus_stats.tx_frames);
+  od.append(CO_KEY(0x3100, 2, CO_OBJ_____R_), CO_TUNSIGNED32, (CO_DATA) &bus_stats.rx_frames);
+  od.append(CO_KEY(0x3100, 3, CO_OBJ_____R_), CO_TUNSIGNED32, (CO_DATA) &recv_frames.overflows);
+  od.append(CO_KEY(0x3100, 4, CO_OBJ_____R_), CO_TUNSIGNED32, (CO_DATA) &recv_frames.high_water);
+  od.append(CO_KEY(0x3100, 5, CO_OBJ_____R_), CO_TUNSIGNED32, (CO_DATA) &bus_stats.rx_filtered);
+  od.append(CO_KEY(0x3100, 6, CO_OBJ_____R_), CO_TUNSIGNED32, (CO_DATA) &bus_stats.sync_missed);
+
+  od.append(CO_KEY(0x3101, 0, CO_OBJ_D___R_), CO_TUNSIGNED8, 8);
+  for (int i = 0; i < 8; i++)
+    od.append(CO_KEY(0x3101, i + 1, CO_OBJ_____R_), CO_TUNSIGNED32, (CO_DATA) &tpdo_sent[i]);
+  od.append(CO_KEY(0x3102, 0, CO_OBJ_D___R_), CO_TUNSIGNED8, 8);
+  for (int i = 0; i < 8; i++)
+    od.append(CO_KEY(0x3102, i + 1, CO_OBJ_____R_), CO_TUNSIGNED32, (CO_DATA) &tpdo_suppressed[i]);
+  od.append(CO_KEY(0x3103, 0, CO_OBJ_D___R_), CO_TUNSIGNED8, 8);
+  for (int i = 0; i < 8; i++)
+    od.append(CO_KEY(0x3103, i + 1, CO_OBJ_____R_), CO_TUNSIGNED8, (CO_DATA) &tpdo_sync_period[i]);
+
+  od.append(CO_KEY(0x3200, 0, CO_OBJ_D___R_), CO_TUNSIGNED8, CANOPEN_GROUP_N);
+  for (uint32_t i = 0; i < CANOPEN_GROUP_N; i++)
+    od.append(CO_KEY(0x3200, i + 1, CO_OBJ_____RW), CO_TUNSIGNED16, (CO_DATA) &group_table[i]);
+
   memset(&status, 0, sizeof(status));
   memset(&last_status, 0, sizeof(last_status));
 
-  CO_OBJ_STR *esphome_ver_str = od_string(ESPHOME_VERSION " " + App.get_compilation_time());
+  CO_OBJ_STR *esphome_ver_str = od_string(od_copy_string(ESPHOME_VERSION " " + App.get_compilation_time()));
   od.add_update(CO_KEY(0x100a, 0, CO_OBJ_____R_), CO_TSTRING, (CO_DATA) esphome_ver_str);
 }
 void CanopenComponent::set_heartbeat_interval(uint16_t interval_ms) { heartbeat_interval_ms = interval_ms; }
 
+void CanopenComponent::write_entity_cmd(uint8_t entity_index, uint8_t cmd, const uint8_t *data, uint8_t size,
+                                        bool broadcast) {
+  auto obj = od.find(ENTITY_CMD_KEY(entity_index, cmd));
+  if (!obj) {
+    if (broadcast)
+      ESP_LOGV(TAG, "No command %d of entity %d, ignoring broadcast command", cmd, entity_index);
+    else
+      ESP_LOGW(TAG, "Can't find command %d of entity %d", cmd, entity_index);
+    return;
+  }
+  if (obj->Type->Size(obj, node, 4) != size) {
+    if (broadcast)
+      ESP_LOGV(TAG, "Command %d of entity %d is not %d-byte command, ignoring broadcast command", cmd, entity_index,
+               size);
+    else
+      ESP_LOGW(TAG, "Command %d of entity %d is not %d-byte command", cmd, entity_index, size);
+    return;
+  }
+  if (COObjWrValue(obj, node, (void *) data, size) != CO_ERR_NONE) {
+    ESP_LOGW(TAG, "Can't write command %d of entity %d", cmd, entity_index);
+  }
+}
+
+void CanopenComponent::parse_od_writer_batch(const uint8_t *data, uint8_t len, bool broadcast) {
+  // base entity index, followed by (entity index delta << 2 | cmd, value) pairs
+  uint8_t entity_index = data[0];
+  if (!entity_index)
+    return;
+  for (uint8_t i = 1; i + 1 < len; i += 2) {
+    entity_index += data[i] >> 2;
+    write_entity_cmd(entity_index, data[i] & 3, data + i + 1, 1, broadcast);
+  }
+}
+
+bool CanopenComponent::is_group_member(uint8_t group, uint8_t entity_index) {
+  for (auto entry : group_table) {
+    if (entry && entry == (group | entity_index << 8))
+      return true;
+  }
+  return false;
+}
+
+void CanopenComponent::parse_od_writer_group(const uint8_t *data, uint8_t len) {
+  // group, entity index (0 - all entities assigned to group), command index, value
+  uint8_t group = data[0];
+  uint8_t entity_index = data[1];
+  if (!group || len < 4)
+    return;
+  if (entity_index) {
+    if (is_group_member(group, 0))
+      write_entity_cmd(entity_index, data[2], data + 3, len - 3, true);
+    return;
+  }
+  for (auto entry : group_table) {
+    if ((entry & 0xff) == group && entry >> 8)
+      write_entity_cmd(entry >> 8, data[2], data + 3, len - 3, true);
+  }
+}
+
 void CanopenComponent::parse_od_writer_frame(CO_IF_FRM *frm) {
+  if ((frm->Identifier & ~0x7f) == OD_WRITER_COB_ID_BASE && !is_od_writer_sender(frm->Identifier & 0x7f)) {
+    ESP_LOGV(TAG, "%03lx: sender doesn't use OD writer format", frm->Identifier);
+    return;
+  }
+  if ((frm->Identifier & ~0x7f) == OD_WRITER_COB_ID_BASE && frm->DLC >= 4 && (frm->Data[0] & 0x80)) {
+    uint8_t target = frm->Data[0] & 0x7f;
+    ESP_LOGI(TAG, "batch cmd from: %02lx target: %02x len: %d", frm->Identifier & 0x7f, target, frm->DLC);
+    if (target == 0 && frm->Data[1] == 0)
+      parse_od_writer_group(frm->Data + 2, frm->DLC - 2);
+    else if (target == 0 || target == node_id)
+      parse_od_writer_batch(frm->Data + 1, frm->DLC - 1, target == 0);
+    return;
+  }
   if ((frm->Identifier & ~0x7f) == OD_WRITER_COB_ID_BASE && frm->DLC > 4 && frm->Data[0] == this->node_id) {
     uint32_t key = ((uint32_t *) frm->Data)[0] >> 8;
     uint32_t value = ((uint32_t *) frm->Data)[1];
@@ -187,7 +292,7 @@ void CanopenComponent::parse_od_writer_frame(CO_IF_FRM *frm) {
       value = value & 0xffffff;
     }
     ESP_LOGI(TAG, "cmd from: %02lx key: %06lx value: %08lx", frm->Identifier & 0x7f, key, value);
-    auto obj = CODictFind(&node->Dict, (key << 8));
+    auto obj = od.find((key << 8));
     if (!obj) {
       ESP_LOGW(TAG, "Can't find object at %04lx %02x", index, subindex);
       return;
@@ -195,21 +300,137 @@ void CanopenComponent::parse_od_writer_frame(CO_IF_FRM *frm) {
     if (COObjWrValue(obj, node, frm->Data + 4, frm->DLC - 4) != CO_ERR_NONE) {
       ESP_LOGW(TAG, "Can't write %d bytes to %04lx %02x", frm->DLC - 4, index, subindex);
     }
+    if (is_rpdo_comm_index(index))
+      rx_filter_dirty = true;
   }
 }
 
-void CanopenComponent::on_frame(uint32_t can_id, bool rtr, const std::vector<uint8_t> &data) {
-  CO_IF_FRM frame = {can_id, {}, (uint8_t) data.size()};
-  memcpy(frame.Data, &data[0], data.size());
-  recv_frames.push_back(frame);
-  // this assumes single-threded ESPHome callbacks
-  current_canopen = this;
+void CanopenComponent::push_frame(const CO_IF_FRM &frm) {
+  if (!rx_filter.accepts(frm.Identifier)) {
+    bus_stats.rx_filtered++;
+    return;
+  }
+  if (!recv_frames.push({frm, esphome::micros()})) {
+    ESP_LOGV(TAG, "rx queue full, dropping frame id: %03lx", frm.Identifier);
+  }
+}
 
-  CONodeProcess(node);
-  if (pdo_od_writer_enabled)
-    parse_od_writer_frame(&frame);
+bool CanopenComponent::read_frame(CO_IF_FRM *frm) {
+  RxFrame frame;
+  if (!recv_frames.pop(frame))
+    return false;
+  *frm = frame.frm;
+  uint32_t latency_us = esphome::micros() - frame.time_us;
+  bus_stats.rx_frames++;
+  bus_stats.rx_latency_sum_us += latency_us;
+  if (latency_us > bus_stats.rx_latency_max_us)
+    bus_stats.rx_latency_max_us = latency_us;
+  return true;
+}
 
-  current_canopen = 0;
+bool CanopenComponent::is_rpdo_cob_id(uint32_t cob_id) {
+  for (int n = 0; n < CO_RPDO_N; n++) {
+    uint32_t rpdo_cob_id;
+    memcpy(&rpdo_cob_id, rpdo_buf[n] + 1, sizeof(rpdo_cob_id));
+    if (rpdo_buf[n][0] && rpdo_cob_id == cob_id)
+      return true;
+  }
+  return false;
+}
+
+void CanopenComponent::process_rx_frames() {
+  uint32_t start_us = esphome::micros();
+  uint32_t count = 0;
+  for (; count < CANOPEN_RX_BATCH; count++) {
+    auto frame = recv_frames.front();
+    if (!frame)
+      break;
+    // OD writer frames are consumed here, unless they are also mapped to RPDO
+    if (pdo_od_writer_enabled && (frame->frm.Identifier & ~0x7f) == OD_WRITER_COB_ID_BASE &&
+        !is_rpdo_cob_id(frame->frm.Identifier)) {
+      CO_IF_FRM frm;
+      read_frame(&frm);
+      parse_od_writer_frame(&frm);
+      continue;
+    }
+#ifdef USE_CANOPEN_OTA
+    if (frame->frm.Identifier == OTA_MULTICAST_COB_ID) {
+      CO_IF_FRM frm;
+      read_frame(&frm);
+      fw_multicast_frame(this, &frm);
+      continue;
+    }
+#endif
+    if (pdo_od_writer_enabled)
+      parse_od_writer_frame(&frame->frm);
+    // SDO writes may change RPDO COB-IDs
+    if (frame->frm.Identifier == CO_COBID_SDO_REQUEST() + node_id)
+      rx_filter_dirty = true;
+    else if (frame->frm.Identifier == SYNC_COB_ID)
+      sync_received();
+    else if (discovery && (frame->frm.Identifier & ~0x7f) == HEARTBEAT_COB_ID_BASE && frame->frm.DLC &&
+             frame->frm.Identifier != HEARTBEAT_COB_ID_BASE + node_id)
+      discovery->on_heartbeat(frame->frm.Identifier & 0x7f, frame->frm.Data[0]);
+    sdo_client.on_frame(frame->frm);
+    CONodeProcess(node);
+  }
+  if (rx_filter_dirty)
+    update_rx_filter();
+  if (count) {
+    bus_stats.rx_process_us += esphome::micros() - start_us;
+    if (count > bus_stats.rx_batch_max)
+      bus_stats.rx_batch_max = count;
+  }
+}
+
+void CanopenComponent::update_rx_filter() {
+  rx_filter_dirty = false;
+  rx_filter.clear();
+  rx_filter.add(NMT_COB_ID);
+  rx_filter.add(SYNC_COB_ID);
+  rx_filter.add(CO_COBID_SDO_REQUEST() + node_id);
+  for (int n = 0; n < CO_CSDO_N; n++) {
+    auto obj = od.find(CO_KEY(0x1280 + n, 2, 0));
+    if (obj)
+      rx_filter.add(obj->Data);
+    // current target of SDO client channel
+    rx_filter.add(node->CSdo[n].RxId);
+  }
+  for (int n = 0; n < CO_RPDO_N; n++) {
+    uint32_t cob_id;
+    memcpy(&cob_id, rpdo_buf[n] + 1, sizeof(cob_id));
+    if (rpdo_buf[n][0] && !(cob_id & PDO_COB_ID_INVALID))
+      rx_filter.add(cob_id);
+  }
+  if (pdo_od_writer_enabled) {
+    for (uint8_t sender = 1; sender < 128; sender++) {
+      if (is_od_writer_sender(sender))
+        rx_filter.add(OD_WRITER_COB_ID_BASE + sender);
+    }
+  }
+  for (uint8_t sub = 1; sub < 128; sub++) {
+    auto obj = od.find(CO_KEY(0x1016, sub, 0));
+    if (!obj)
+      break;
+    rx_filter.add(HEARTBEAT_COB_ID_BASE + ((CO_HBCONS *) obj->Data)->NodeId);
+  }
+  if (discovery)
+    rx_filter.add_range(HEARTBEAT_COB_ID_BASE + 1, HEARTBEAT_COB_ID_BASE + 0x7f);
+#ifdef USE_CANOPEN_OTA
+  if (FirmwareObj.multicast)
+    rx_filter.add(OTA_MULTICAST_COB_ID);
+#endif
+}
+
+void CanopenComponent::on_frame(uint32_t can_id, bool rtr, const std::vector<uint8_t> &data) {
+  if (data.size() > CAN_MAX_DLC) {
+    ESP_LOGW(TAG, "dropping frame id: %03lx with unsupported length: %d", can_id, data.size());
+    return;
+  }
+  CO_IF_FRM frame = {can_id, {}, (uint8_t) data.size()};
+  memcpy(frame.Data, data.data(), data.size());
+  // frames are processed in batches in loop()
+  push_frame(frame);
 }
 
 void CanopenComponent::set_canbus(canbus::Canbus *canbus) {
@@ -218,27 +439,38 @@ void CanopenComponent::set_canbus(canbus::Canbus *canbus) {
                                     const std::vector<uint8_t> &data) -> void { this->on_frame(can_id, rtr, data); });
 }
 
-void CanopenComponent::od_add_metadata(uint32_t entity_id, uint32_t type, const std::string &name,
-                                       const std::string &device_class, const std::string &unit,
-                                       const std::string &state_class) {
+void CanopenComponent::od_add_metadata(uint32_t entity_id, uint32_t type, const char *name, const char *device_class,
+                                       const char *unit, const char *state_class) {
   uint32_t index = ENTITY_INDEX(entity_id);
   od.add_update(CO_KEY(0x2001, entity_id, CO_OBJ_D___R_), CO_TUNSIGNED32, (CO_DATA) type);
-  if (name.size())
+  descriptor_builder.add(entity_id, type, name, device_class, unit, state_class);
+  if (compact_metadata)
+    return;
+  if (name && *name)
     od.add_update(CO_KEY(index, ENTITY_INDEX_NAME, CO_OBJ_____R_), CO_TSTRING, (CO_DATA) od_string(name));
-  if (device_class.size())
+  if (device_class && *device_class)
     od.add_update(CO_KEY(index, ENTITY_INDEX_DEVICE_CLASS, CO_OBJ_____R_), CO_TSTRING,
                   (CO_DATA) od_string(device_class));
-  if (unit.size())
+  if (unit && *unit)
     od.add_update(CO_KEY(index, ENTITY_INDEX_UNIT, CO_OBJ_____R_), CO_TSTRING, (CO_DATA) od_string(unit));
-  if (state_class.size())
+  if (state_class && *state_class)
     od.add_update(CO_KEY(index, ENTITY_INDEX_STATE_CLASS, CO_OBJ_D___R_), CO_TSTRING, (CO_DATA) od_string(state_class));
 }
 
+void CanopenComponent::od_add_metadata(uint32_t entity_id, uint32_t type, const std::string &name,
+                                       const std::string &device_class, const std::string &unit,
+                                       const std::string &state_class) {
+  od_add_metadata(entity_id, type, name.size() ? od_copy_string(name) : "",
+                  device_class.size() ? od_copy_string(device_class) : "", unit.size() ? od_copy_string(unit) : "",
+                  state_class.size() ? od_copy_string(state_class) : "");
+}
+
 void CanopenComponent::od_add_min_max_metadata(uint32_t entity_id, float min_value, float max_value) {
   uint32_t index = ENTITY_INDEX(entity_id);
   // temporary pointers to get rid of aliasing warning
   uint32_t *min_value_ptr = (uint32_t *) &min_value;
   uint32_t *max_value_ptr = (uint32_t *) &max_value;
+  descriptor_builder.set_min_max(entity_id, min_value, max_value);
   od.add_update(CO_KEY(index, ENTITY_INDEX_SENSOR_MIN_VALUE, CO_OBJ_D___R_), CO_TUNSIGNED32, (CO_DATA) *min_value_ptr);
   od.add_update(CO_KEY(index, ENTITY_INDEX_SENSOR_MAX_VALUE, CO_OBJ_D___R_), CO_TUNSIGNED32, (CO_DATA) *max_value_ptr);
 }
@@ -266,9 +498,21 @@ uint32_t CanopenComponent::od_add_state(uint32_t entity_id, const CO_OBJ_TYPE *t
 }
 
 void CanopenComponent::od_setup_tpdo(uint32_t index, uint8_t sub_index, uint8_t size, TPDO &tpdo) {
+  if (tpdo.number >= 8 || tpdo_size[tpdo.number] + size > CAN_MAX_DLC) {
+    ESP_LOGE(TAG, "can't map %04lx:%02x (%d bytes) to TPDO %d, PDO is full", index, sub_index, size, tpdo.number);
+    return;
+  }
+  tpdo_size[tpdo.number] += size;
   od.add_update(CO_KEY(0x1800 + tpdo.number, 1, CO_OBJ_DN__R_), CO_TUNSIGNED32,
                 tpdo.number < 4 ? CO_COBID_TPDO_DEFAULT(tpdo.number) : CO_COBID_TPDO_DEFAULT(tpdo.number - 4) + 0x80);
-  od.add_update(CO_KEY(0x1800 + tpdo.number, 2, CO_OBJ_D___R_), CO_TUNSIGNED8, (CO_DATA) 254);
+  // synchronous TPDOs are triggered by process_sync(), transmission type seen by canopen-stack stays 254,
+  // otherwise its SYNC consumer would send them too
+  if (tpdo.sync)
+    tpdo_sync_period[tpdo.number] = tpdo.sync;
+  if (tpdo.inhibit_time)
+    tpdo_inhibit_time[tpdo.number] = tpdo.inhibit_time;
+  if (tpdo.event_timer)
+    tpdo_event_timer[tpdo.number] = tpdo.event_timer;
 
   uint8_t tpdo_sub_index = 0;
   auto obj = od.find(CO_DEV(0x1a00 + tpdo.number, 0));
@@ -281,7 +525,7 @@ void CanopenComponent::od_setup_tpdo(uint32_t index, uint8_t sub_index, uint8_t
 }
 
 void CanopenComponent::od_set_state(uint32_t key, void *state, uint8_t size) {
-  auto obj = CODictFind(&node->Dict, key);
+  auto obj = od.find(key);
   if (!obj)
     return;
   if (!size) {
@@ -302,10 +546,17 @@ uint32_t CanopenComponent::od_add_cmd(uint32_t entity_id, std::function<void(voi
 
   od.add_update(CO_KEY(index + 2, max_index, CO_OBJ_D___RW), type, (CO_DATA) 0);
   auto key = CO_KEY(index + 2, max_index, 0);
-  can_cmd_handlers[key] = cb;
+  cmd_handlers.set(key, cb);
   return key;
 }
 
+void CanopenComponent::dispatch_cmd(uint32_t key, void *buffer, uint32_t size) {
+  auto cb = cmd_handlers.find(key);
+  if (cb) {
+    (*cb)(buffer, size);
+  }
+}
+
 void CanopenComponent::rpdo_map_append(uint8_t idx, uint32_t index, uint8_t sub, uint8_t bit_size) {
   auto obj = od.find(CO_DEV(0x1600 + idx, 0));
   if (!obj) {
@@ -388,6 +639,9 @@ CO_OBJ_DOM FirmwareMD5 = {
     sizeof(FirmwareObj.md5),
     FirmwareObj.md5,
 };
+
+// MD5 of image written to flash, hex encoded
+CO_OBJ_DOM ImageMD5Obj = {0, 32, nullptr};
 #endif
 
 void CanopenComponent::setup_csdo(uint8_t num, uint8_t node_id, uint32_t tx_id, uint32_t rx_id) {
@@ -395,23 +649,34 @@ void CanopenComponent::setup_csdo(uint8_t num, uint8_t node_id, uint32_t tx_id,
   od.add_update(CO_KEY(0x1280 + num, 1, CO_OBJ_D___R_), CO_TUNSIGNED32, tx_id);
   od.add_update(CO_KEY(0x1280 + num, 2, CO_OBJ_D___R_), CO_TUNSIGNED32, rx_id);
   od.add_update(CO_KEY(0x1280 + num, 3, CO_OBJ_D___R_), CO_TUNSIGNED8, node_id);
+  if (num < CO_CSDO_N) {
+    auto &target = csdo_targets[num];
+    target.node_id = node_id;
+    target.tx_id = tx_id;
+    target.rx_id = rx_id;
+  }
 }
 
 void CanopenComponent::od_set_string(uint32_t index, uint32_t sub, const char *value) {
+  od_set_static_string(index, sub, od_copy_string(value));
+}
+
+void CanopenComponent::od_set_static_string(uint32_t index, uint32_t sub, const char *value) {
   od.add_update(CO_KEY(index, sub, CO_OBJ_____R_), CO_TSTRING, (CO_DATA) od_string(value));
 }
 
 float CanopenComponent::get_setup_priority() const { return setup_priority::PROCESSOR; }
 
 void CanopenComponent::setup() {
+  uint32_t setup_start_us = esphome::micros();
   all_instances.push_back(this);
   current_canopen = this;
 
-  //  hfq_requester.start();
-
   ESP_LOGCONFIG(TAG, "Setting up CANopen...");
   ESP_LOGI(TAG, "node name: %s, node_id: %02x", esphome::App.get_name().c_str(), this->node_id);
-  ESP_LOGI(TAG, "high frequency loop: %d", hfq_requester.is_high_frequency());
+  if (!canbus) {
+    ESP_LOGI(TAG, "no canbus configured, using virtual bus");
+  }
   ESP_LOGD(TAG, "CO_TPDO_N: %d", CO_TPDO_N);
   ESP_LOGD(TAG, "CO_RPDO_N: %d", CO_RPDO_N);
 
@@ -428,23 +693,36 @@ void CanopenComponent::setup() {
   } else {
     ESP_LOGI(TAG, "can't load RPDO config from preferences, using defaults");
   }
+  this->group_state = global_preferences->make_preference<uint16_t[CANOPEN_GROUP_N]>(
+      fnv1_hash("canopen_groups_v1_" + to_string(node_id)), true);
+  if (this->group_state.load(&group_table)) {
+    ESP_LOGI(TAG, "loaded group membership from preferences");
+  }
 #endif
 
   if (heartbeat_interval_ms) {
     od.add_update(CO_KEY(0x1017, 0, CO_OBJ_D___RW), CO_THB_PROD, (CO_DATA) (heartbeat_interval_ms));
   }
 
+  // SYNC COB-ID (bit 30 set if node is SYNC producer) and communication cycle period
+  od.add_update(CO_KEY(0x1005, 0, CO_OBJ_D___R_), CO_TUNSIGNED32,
+                (CO_DATA) (SYNC_COB_ID | (sync_period_us ? 1ul << 30 : 0)));
+  od.add_update(CO_KEY(0x1006, 0, CO_OBJ_D___R_), CO_TUNSIGNED32, (CO_DATA) sync_period_us);
+
   // manufacturer device name
-  od_set_string(0x1008, 0, App.get_name().c_str());
+  od_set_static_string(0x1008, 0, App.get_name().c_str());
 
   for (uint8_t i = 0; i < 8; i++) {
     od.add_update(CO_KEY(0x1800 + i, 1, CO_OBJ_DN__R_), CO_TUNSIGNED32,
                   i < 4 ? CO_COBID_TPDO_DEFAULT(i) : CO_COBID_TPDO_DEFAULT(i - 4) + 0x80);
     od.add_update(CO_KEY(0x1800 + i, 2, CO_OBJ_D___R_), CO_TUNSIGNED8, (CO_DATA) 254);
+    // read by canopen-stack when TPDO is (re)initialized, so written values apply after NMT reset communication
+    od.add_update(CO_KEY(0x1800 + i, 3, CO_OBJ_____RW), CO_TUNSIGNED16, (CO_DATA) &tpdo_inhibit_time[i]);
+    od.add_update(CO_KEY(0x1800 + i, 5, CO_OBJ_____RW), CO_TUNSIGNED16, (CO_DATA) &tpdo_event_timer[i]);
   }
 
 #ifdef USE_CANOPEN_OTA
-  FirmwareObj.domain.Size = 1024 * 1024;
+  FirmwareObj.domain.Size = FW_IMAGE_MAX_SIZE;
 
   od.add_update(CO_KEY(0x3000, 1, CO_OBJ_D____W), FW_CTRL, (CO_DATA) 0);
   od.add_update(CO_KEY(0x3000, 2, CO_OBJ_____RW), CO_TUNSIGNED32, (CO_DATA) (&FirmwareObj.size));
@@ -453,14 +731,39 @@ void CanopenComponent::setup() {
   uint32_t flags = 0;
 #ifdef OTA_COMPRESSION
   flags |= 1;
+#endif
+  // interrupted upload can be resumed (FW_CTRL_RESUME), image can be streamed to many nodes (FW_CTRL_MULTICAST)
+  flags |= 2 | 4;
+#ifdef USE_ESP32
+  // delta images, patching running firmware
+  flags |= 8;
 #endif
   od.add_update(CO_KEY(0x3000, 5, CO_OBJ_D___R_), CO_TUNSIGNED32, flags);
+  od.add_update(CO_KEY(0x3000, 6, CO_OBJ_____R_), CO_TUNSIGNED32, (CO_DATA) (&FirmwareObj.domain.Offset));
+  od.add_update(CO_KEY(0x3000, 7, CO_OBJ_____R_), CO_TUNSIGNED32, (CO_DATA) (&FirmwareObj.crc));
+  od.add_update(CO_KEY(0x3000, 8, CO_OBJ_____RW), CO_TUNSIGNED32, (CO_DATA) (&FirmwareObj.multicast_size));
+  od.add_update(CO_KEY(0x3000, 9, CO_OBJ_____R_), CO_TUNSIGNED32, (CO_DATA) (&FirmwareObj.multicast_missed));
+  od.add_update(CO_KEY(0x3001, 1, CO_OBJ_D___R_), CO_TUNSIGNED32, (CO_DATA) CANOPEN_OTA_CHUNK_SIZE);
+  od.add_update(CO_KEY(0x3001, 2, CO_OBJ_____R_), CO_TUNSIGNED32, (CO_DATA) (&FirmwareObj.chunks));
+  od.add_update(CO_KEY(0x3001, 3, CO_OBJ_____R_), CO_TDOMAIN, (CO_DATA) (&FirmwareChunkCrcObj));
+  if (ota) {
+    ImageMD5Obj.Start = (uint8_t *) ota->get_image_md5();
+    od.add_update(CO_KEY(0x3001, 4, CO_OBJ_____R_), CO_TDOMAIN, (CO_DATA) (&ImageMD5Obj));
+    od.add_update(CO_KEY(0x3000, 0x0A, CO_OBJ_____R_), CO_TUNSIGNED8, (CO_DATA) (&ota->state));
+    od.add_update(CO_KEY(0x3000, 0x0B, CO_OBJ_____R_), CO_TUNSIGNED8, (CO_DATA) (&ota->state_error));
+  }
 #endif
 
   for (auto it = entities.begin(); it != entities.end(); it++) {
     (*it)->setup(this);
   }
 
+  descriptor = descriptor_builder.build();
+  descriptor_obj = {0, (uint32_t) descriptor.size(), descriptor.data()};
+  od.add_update(CO_KEY(0x2FFF, 0, CO_OBJ_D___R_), CO_TUNSIGNED8, (CO_DATA) 2);
+  od.add_update(CO_KEY(0x2FFF, 1, CO_OBJ_D___R_), CO_TUNSIGNED32, (CO_DATA) descriptor.size());
+  od.add_update(CO_KEY(0x2FFF, 2, CO_OBJ_____R_), CO_TDOMAIN, (CO_DATA) (&descriptor_obj));
+
   CO_NODE_SPEC_T NodeSpec = {
       (uint8_t) node_id,    /* default Node-Id                */
       APP_BAUDRATE,         /* default Baudrate               */
@@ -475,17 +778,26 @@ void CanopenComponent::setup() {
   };
 
   CONodeInit(node, &NodeSpec);
+  sdo_client.set_node(node);
   auto err = CONodeGetErr(node);
   if (err != CO_ERR_NONE) {
     ESP_LOGE(TAG, "canopen init error: %d", err);
   }
 
+  ESP_LOGI(TAG, "object dictionary: %d entries, %d strings, entity descriptor: %d bytes, setup took %ldus",
+           od.od.size(), od_strings.size(), descriptor.size(), esphome::micros() - setup_start_us);
+  if (od_strings.size() == od_strings.capacity()) {
+    ESP_LOGW(TAG, "OD string pool exhausted, increase CANOPEN_OD_STR_N");
+  }
+#ifdef USE_ESP32
+  ESP_LOGI(TAG, "free heap size: %ld", esp_get_free_heap_size());
+#endif
+#ifdef USE_STM32
+  ESP_LOGI(TAG, "free heap size: %ld", ::get_free_heap_size());
+#endif
+
   CONodeStart(node);
   set_pre_operational_mode();
-
-  // #ifdef USE_STM32
-  // ESP_LOGI(TAG, "free heap size: %d", ::get_free_heap_size());
-  // #endif
 }
 
 void CanopenComponent::set_pre_operational_mode() {
@@ -506,6 +818,8 @@ void CanopenComponent::set_operational_mode() {
   // update dictionary size
   // as new entries may have been added on pre_operational phase
   node->Dict.Num = od.od.size();
+  od.freeze();
+  update_rx_filter();
   CONmtSetMode(&node->Nmt, CO_OPERATIONAL);
   current_canopen = 0;
 
@@ -549,7 +863,7 @@ bool CanopenComponent::remote_entity_write_od(uint8_t node_id, uint32_t index, u
   }
   if (node_id == this->node_id) {
     uint32_t key = CO_KEY(index, subindex, 0);
-    auto obj = CODictFind(&node->Dict, key);
+    auto obj = od.find(key);
     if (!obj) {
       ESP_LOGW(TAG, "Can't find object at %04lx %02x", index, subindex);
       return false;
@@ -558,6 +872,8 @@ bool CanopenComponent::remote_entity_write_od(uint8_t node_id, uint32_t index, u
     if (result != CO_ERR_NONE) {
       ESP_LOGW(TAG, "Can't write %d bytes to %04lx %02x", size, index, subindex);
     }
+    if (is_rpdo_comm_index(index))
+      rx_filter_dirty = true;
   }
 
   CO_IF_FRM frame = {OD_WRITER_COB_ID_BASE | node_id, {}, (uint8_t) (size + 4)};
@@ -578,44 +894,119 @@ bool CanopenComponent::remote_entity_write_od(uint8_t node_id, uint32_t index, u
   return true;
 }
 
+uint16_t CanopenComponent::remote_entity_write_od_batch(uint8_t node_id, std::vector<EntityCmd> cmds) {
+  if (node_id >= 128)
+    return 0;
+  std::stable_sort(cmds.begin(), cmds.end(),
+                   [](const EntityCmd &a, const EntityCmd &b) { return a.entity_index < b.entity_index; });
+
+  cmds.erase(std::remove_if(cmds.begin(), cmds.end(),
+                            [](const EntityCmd &c) {
+                              if (c.entity_index && c.cmd < 4)
+                                return false;
+                              ESP_LOGW(TAG, "can't batch command %d of entity %d", c.cmd, c.entity_index);
+                              return true;
+                            }),
+             cmds.end());
+
+  uint16_t frames = 0;
+  CO_IF_FRM frame = {OD_WRITER_COB_ID_BASE | this->node_id, {}, 0};
+  uint8_t prev_index = 0;
+  for (auto it = cmds.begin(); it != cmds.end(); it++) {
+    if (!frame.DLC) {
+      frame.Data[0] = 0x80 | node_id;
+      frame.Data[1] = prev_index = it->entity_index;
+      frame.DLC = 2;
+    }
+    frame.Data[frame.DLC++] = (it->entity_index - prev_index) << 2 | it->cmd;
+    frame.Data[frame.DLC++] = it->value;
+    prev_index = it->entity_index;
+
+    auto next = it + 1;
+    if (next == cmds.end() || frame.DLC + 2 > CAN_MAX_DLC || next->entity_index - prev_index >= 64) {
+      if (node_id == 0 || node_id == this->node_id)
+        parse_od_writer_batch(frame.Data + 1, frame.DLC - 1, node_id == 0);
+      current_canopen = this;
+      node->If.Drv->Can->Send(&frame);
+      current_canopen = 0;
+      frame.DLC = 0;
+      frames++;
+    }
+  }
+  return frames;
+}
+
+void CanopenComponent::add_group(uint8_t group, uint8_t entity_index) {
+  uint16_t entry = group | entity_index << 8;
+  if (!group || is_group_member(group, entity_index))
+    return;
+  for (auto &e : group_table) {
+    if (!e) {
+      e = entry;
+      return;
+    }
+  }
+  ESP_LOGE(TAG, "group table is full, can't add group %d (entity %d)", group, entity_index);
+}
+
+bool CanopenComponent::remote_group_write_od(uint8_t group, uint8_t entity_index, uint8_t cmd, void *data,
+                                             uint8_t size) {
+  if (!group || size < 1 || size > 2) {
+    return false;
+  }
+  CO_IF_FRM frame = {OD_WRITER_COB_ID_BASE | this->node_id, {0x80, 0, group, entity_index, cmd},
+                     (uint8_t) (size + 5)};
+  memcpy(frame.Data + 5, data, size);
+  parse_od_writer_group(frame.Data + 2, frame.DLC - 2);
+
+  current_canopen = this;
+  node->If.Drv->Can->Send(&frame);
+  current_canopen = 0;
+  return true;
+}
+
 void CanopenComponent::csdo_recv(uint8_t num, uint32_t key, std::function<void(uint32_t, uint32_t)> cb) {
-  static auto csdo0 = COCSdoFind(node, 0);
-  if (!csdo0) {
+  if (num >= CO_CSDO_N) {
     return cb(0, -1);
   }
-  static uint32_t buffers[CO_CSDO_N];
-  static std::function<void(uint32_t, uint32_t)> callbacks[CO_CSDO_N];
-  auto csdo = COCSdoFind(node, num);
-  if (csdo) {
-    buffers[num] = 0;
-    callbacks[num] = cb;
-    auto ret = COCSdoRequestUpload(
-        csdo, key, (uint8_t *) &buffers[num], 4,
-        [](CO_CSDO_T *csdo, uint16_t index, uint8_t sub, uint32_t code) {
-          auto num = csdo - csdo0;
-          ESP_LOGV(TAG, "COCSdoRequestUpload cb: %04x %02x %08lx", index, sub, code);
-          callbacks[num](buffers[num], code);
-        },
-        1000);
-  } else {
-    cb(0, -1);
+  // tx_id 0 would send request as NMT frame
+  if (!csdo_targets[num].node_id || !csdo_targets[num].tx_id) {
+    ESP_LOGW(TAG, "SDO client channel %d is not configured", num);
+    return cb(0, SDO_ABORT_GENERAL);
   }
+  SdoRequest req = csdo_targets[num];
+  req.key = key;
+  req.upload = true;
+  req.data.resize(4);
+  req.timeout_ms = sdo_client.default_timeout_ms;
+  req.retries = sdo_client.default_retries;
+  req.cb = [cb](SdoRequest &req, uint32_t code) {
+    uint32_t value;
+    memcpy(&value, req.data.data(), sizeof(value));
+    cb(value, code);
+  };
+  sdo_client.submit(std::move(req));
 }
 
 void CanopenComponent::csdo_send_data(uint8_t num, uint32_t key, uint8_t *data, uint8_t len) {
-  auto csdo = COCSdoFind(node, num);
-  if (csdo) {
-    auto ret = COCSdoRequestDownload(
-        csdo, key, data, len,
-        [](CO_CSDO_T *csdo, uint16_t index, uint8_t sub, uint32_t code) {
-          ESP_LOGV(TAG, "COCSdoRequestDownload cb: %04x %02x %08lx", index, sub, code);
-        },
-        1000);
-
-    if (ret) {
-      ESP_LOGE(TAG, "COCSdoRequestDownload err: %08x", ret);
-    }
+  if (num >= CO_CSDO_N)
+    return;
+  if (!csdo_targets[num].node_id || !csdo_targets[num].tx_id) {
+    ESP_LOGW(TAG, "SDO client channel %d is not configured", num);
+    return;
   }
+  SdoRequest req = csdo_targets[num];
+  req.key = key;
+  req.upload = false;
+  req.data.assign(data, data + len);
+  req.timeout_ms = sdo_client.default_timeout_ms;
+  req.retries = sdo_client.default_retries;
+  req.cb = [](SdoRequest &req, uint32_t code) {
+    if (code) {
+      ESP_LOGW(TAG, "SDO download to node %02x failed: %08lx", req.node_id, code);
+    }
+  };
+  sdo_client.submit(std::move(req));
 }
 
 bool CanopenComponent::get_can_status(CanStatus &status_info) {
@@ -643,7 +1034,7 @@ void CanopenComponent::initiate_recovery() {
 
 void CanopenComponent::store_comm_params() {
 #ifdef USE_ESP32
-  if (comm_state.save(&rpdo_buf)) {
+  if (comm_state.save(&rpdo_buf) && group_state.save(&group_table)) {
     global_preferences->sync();
     ESP_LOGI(TAG, "Stored communication params in NVM");
   } else {
@@ -669,27 +1060,118 @@ void CanopenComponent::setup_heartbeat_client(uint8_t subidx, uint8_t node_id, u
   od.add_update(CO_KEY(0x1016, subidx, CO_OBJ_____RW), CO_THB_CONS, (CO_DATA) thb_cons);
 }
 
-void CanopenComponent::loop() {
-  ESP_LOGVV(TAG, "loop start, node_id: %d", node_id);
+void CanopenComponent::send_sync() {
+  CO_IF_FRM frame = {SYNC_COB_ID, {}, 0};
   current_canopen = this;
-  COTmrService(&node->Tmr);
-  COTmrProcess(&node->Tmr);
+  node->If.Drv->Can->Send(&frame);
+  current_canopen = 0;
+  // own SYNC frame is not received back
+  sync_received();
+}
 
-  while (recv_frames.size() > 0) {
-    if (pdo_od_writer_enabled)
-      parse_od_writer_frame(&recv_frames[0]);
-    CONodeProcess(node);
+void CanopenComponent::sync_received() {
+  // SYNCs are counted until next process_sync(), excess ones are dropped (synchronous TPDOs skip a cycle)
+  if (pending_syncs == UINT8_MAX)
+    bus_stats.sync_missed++;
+  else
+    pending_syncs++;
+}
+
+void CanopenComponent::process_sync() {
+  for (; pending_syncs; pending_syncs--) {
+    sync_count++;
+    for (int8_t tpdo_nr = 0; tpdo_nr < 8; tpdo_nr++) {
+      if (tpdo_sync_period[tpdo_nr] && sync_count % tpdo_sync_period[tpdo_nr] == 0)
+        trig_tpdo(tpdo_nr);
+    }
   }
+}
 
-  current_canopen = 0;
+int8_t CanopenComponent::tpdo_number(uint32_t cob_id) {
+  // COB-IDs are taken from 0x1800 + N:01, so TPDOs with non-default COB-IDs are counted too
+  for (int8_t tpdo_nr = 0; tpdo_nr < 8; tpdo_nr++) {
+    if (!tpdo_size[tpdo_nr] || (tpdo_nr == 7 && pdo_od_writer_enabled))
+      continue;
+    auto obj = od.find(CO_DEV(0x1800 + tpdo_nr, 1));
+    uint32_t tpdo_cob_id;
+    if (!obj || COObjRdValue(obj, node, &tpdo_cob_id, sizeof(tpdo_cob_id)) != CO_ERR_NONE)
+      continue;
+    // bit 31: PDO disabled
+    if (!(tpdo_cob_id & 0x80000000) && (tpdo_cob_id & 0x7ff) == cob_id)
+      return tpdo_nr;
+  }
+  return -1;
+}
+
+void CanopenComponent::tpdo_state_changed(int8_t tpdo_nr) {
+  auto &inhibit = tpdo_inhibit[tpdo_nr];
+  if (!tpdo_inhibit_time[tpdo_nr] || clock->now_us() >= inhibit.until_us)
+    return;
+  // state changes within inhibit window are coalesced into single frame
+  if (inhibit.pending)
+    tpdo_suppressed[tpdo_nr]++;
+  inhibit.pending = true;
+}
+
+void CanopenComponent::tpdo_transmitted(int8_t tpdo_nr) {
+  tpdo_sent[tpdo_nr]++;
+  tpdo_inhibit[tpdo_nr] = {clock->now_us() + tpdo_inhibit_time[tpdo_nr] * 100ull, false};
+}
 
+void CanopenComponent::flush_tpdos() {
   for (int8_t tpdo_nr = 0; tpdo_nr < 8; tpdo_nr++) {
     if (dirty_tpdo_mask & (1 << tpdo_nr)) {
-      ESP_LOGD(TAG, "sending dirty tpdo #%d", tpdo_nr);
+      ESP_LOGV(TAG, "sending tpdo #%d", tpdo_nr);
       trig_tpdo(tpdo_nr);
     }
   }
   dirty_tpdo_mask = 0;
+}
+
+void CanopenComponent::update_hfq_requester() {
+  bool pending = !recv_frames.empty();
+  if (!pending && next_timer_us) {
+    int64_t dt = next_timer_us - clock->now_us();
+    pending = dt < hfq_window_us;
+  }
+  // SYNC is produced only in operational state, next_sync_us is 0 until first SYNC is sent
+  if (!pending && sync_period_us && next_sync_us && node->Nmt.Mode == CO_OPERATIONAL) {
+    int64_t dt = next_sync_us - clock->now_us();
+    pending = dt < hfq_window_us;
+  }
+  if (pending) {
+    hfq_requester.start();
+  } else {
+    hfq_requester.stop();
+  }
+}
+
+void CanopenComponent::loop() {
+  ESP_LOGVV(TAG, "loop start, node_id: %d", node_id);
+  current_canopen = this;
+  if (timer_expired(clock->now_us())) {
+    COTmrService(&node->Tmr);
+    COTmrProcess(&node->Tmr);
+  }
+
+  process_rx_frames();
+  sdo_client.loop();
+
+  current_canopen = 0;
+
+  if (sync_period_us && node->Nmt.Mode == CO_OPERATIONAL) {
+    uint64_t now_us = clock->now_us();
+    if (now_us >= next_sync_us) {
+      // keep fixed cycle, unless we are late by more than one period
+      next_sync_us = (now_us - next_sync_us < sync_period_us ? next_sync_us : now_us) + sync_period_us;
+      send_sync();
+    }
+  }
+  process_sync();
+
+  flush_tpdos();
+
+  update_hfq_requester();
 
   uint32_t now_ms = esphome::millis();
 
@@ -703,6 +1185,18 @@ void CanopenComponent::loop() {
       }
       last_status = status;
     }
+    if (bus_stats.rx_frames) {
+      ESP_LOGD(TAG, "node_id: %d, tx: %ld, rx: %ld, rx latency avg: %ldus, max: %ldus", node_id, bus_stats.tx_frames,
+               bus_stats.rx_frames, (uint32_t) (bus_stats.rx_latency_sum_us / bus_stats.rx_frames),
+               bus_stats.rx_latency_max_us);
+      ESP_LOGD(TAG, "node_id: %d, rx processing: %ldus/frame, max batch: %ld, filtered: %ld", node_id,
+               (uint32_t) (bus_stats.rx_process_us / bus_stats.rx_frames), bus_stats.rx_batch_max,
+               bus_stats.rx_filtered);
+    }
+    if (recv_frames.overflows) {
+      ESP_LOGW(TAG, "rx queue overflows: %ld, high water mark: %ld/%ld", recv_frames.overflows, recv_frames.high_water,
+               recv_frames.capacity());
+    }
     // #ifdef USE_STM32
     //     ESP_LOGI(TAG, "free heap size: %d", ::get_free_heap_size());
     // #endif
@@ -3,6 +3,13 @@
 #include "entities.h"
 #include "driver_can.h"
 #include "od.h"
+#include "ring_buffer.h"
+#include "clock.h"
+#include "cob_id_filter.h"
+#include "cmd_table.h"
+#include "sdo_client.h"
+#include "discovery.h"
+#include "descriptor.h"
 #include "esphome/core/helpers.h"
 
 const int8_t ENTITY_TYPE_DISABLED = 0;
@@ -54,6 +61,9 @@ namespace esphome {
 
 namespace canopen {
 
+// returns copy of str which is never freed, for strings referenced from object dictionary
+const char *od_copy_string(const std::string &str);
+
 struct CanStatus {
   uint8_t state;
   uint32_t tx_err;
@@ -64,7 +74,31 @@ struct CanStatus {
   uint32_t bus_err;
 };
 
+struct BusStats {
+  uint32_t tx_frames;
+  uint32_t rx_frames;
+  uint32_t rx_latency_max_us;
+  uint64_t rx_latency_sum_us;
+  uint32_t rx_filtered;
+  uint32_t sync_missed;
+  uint32_t rx_batch_max;
+  uint64_t rx_process_us;
+};
+
+// inhibit window of TPDO, tracked for suppressed frame counters (coalescing is done by canopen-stack)
+struct TpdoInhibit {
+  uint64_t until_us;
+  bool pending;  // state changed within window, frame is sent when it ends
+};
+
+struct RxFrame {
+  CO_IF_FRM frm;
+  uint32_t time_us;
+};
+
 const uint32_t status_update_interval_ms = 5000;
+// high frequency loop is requested when next timer event is closer than regular loop interval
+const uint32_t hfq_window_us = 20000;
 
 class OperationalTrigger : public Trigger<> {};
 class PreOperationalTrigger : public Trigger<> {};
@@ -86,6 +120,22 @@ class CmdTriggerInt32 : public Trigger<int32_t> {};
 #define APP_OBJ_N 512u /* Object dictionary max size  */
 #endif
 
+#ifndef CANOPEN_OD_STR_N
+#define CANOPEN_OD_STR_N 64u /* Number of preallocated OD string objects */
+#endif
+
+#ifndef CANOPEN_RX_BATCH
+#define CANOPEN_RX_BATCH 16u /* Max number of frames processed in single loop */
+#endif
+
+#ifndef CANOPEN_GROUP_N
+#define CANOPEN_GROUP_N 8u /* Number of group membership entries */
+#endif
+
+#ifndef CANOPEN_RX_QUEUE_LEN
+#define CANOPEN_RX_QUEUE_LEN 32u /* Received frames queue size, power of 2 */
+#endif
+
 enum EMCY_CODES {
   APP_ERR_ID_EEPROM = 0,
   APP_ERR_ID_NUM /* number of EMCY error codes in application */
@@ -93,6 +143,18 @@ enum EMCY_CODES {
 
 class CanopenComponent;
 
+// single byte entity command, used by batched OD writer
+// group address for send_entity_cmd(), see add_group()
+struct EntityGroup {
+  uint8_t id;
+};
+
+struct EntityCmd {
+  uint8_t entity_index;
+  uint8_t cmd;
+  uint8_t value;
+};
+
 struct CanopenNode {
   CO_NODE node;
   CanopenComponent *canopen;
@@ -100,8 +162,12 @@ struct CanopenNode {
 
 class CanopenComponent : public Component {
  protected:
-  // for timer driver
-  uint64_t next_timer_us;
+  // for timer driver, may be replaced with set_clock()
+  MonotonicClock default_clock;
+  MonotonicClock *clock = &default_clock;
+  uint64_t next_timer_us = 0;
+  bool timer_expired(uint64_t now_us) { return next_timer_us && (int64_t) (next_timer_us - now_us) <= 0; }
+  void update_hfq_requester();
 
   /* Each software timer needs some memory for managing
    * the lists and states of the timed action events.
@@ -126,10 +192,29 @@ class CanopenComponent : public Component {
   uint8_t rpdo_buf[CO_RPDO_N][41];
 
   ObjectDictionary od;
+  std::vector<CO_OBJ_STR> od_strings;
+  CO_OBJ_STR *od_string(const char *str);
+  EntityDescriptorBuilder descriptor_builder;
+  std::vector<uint8_t> descriptor;
+  CO_OBJ_DOM descriptor_obj = {};
+  bool compact_metadata = false;
   HighFrequencyLoopRequester hfq_requester;
 
-  std::vector<CO_IF_FRM> recv_frames;
+  RingBuffer<RxFrame, CANOPEN_RX_QUEUE_LEN> recv_frames;
+  BusStats bus_stats = {};
+  // reused for every transmitted frame to avoid heap allocation in DrvCanSend
+  std::vector<uint8_t> tx_data;
+  void push_frame(const CO_IF_FRM &frm);
+  bool read_frame(CO_IF_FRM *frm);
+  bool is_rpdo_cob_id(uint32_t cob_id);
+  CobIdFilter rx_filter;
+  bool rx_filter_dirty = false;
+  // RPDO communication parameters (COB-IDs), changed by SDO / OD writer writes
+  static bool is_rpdo_comm_index(uint32_t index) { return index >= 0x1400 && index <= 0x15FF; }
+  void update_rx_filter();
+  void process_rx_frames();
   friend class BaseCanopenEntity;
+  friend class SdoClient;
 
   friend int16_t esphome::canopen::DrvCanSend(CO_IF_FRM *frm);
   friend int16_t esphome::canopen::DrvCanRead(CO_IF_FRM *frm);
@@ -143,6 +228,9 @@ class CanopenComponent : public Component {
 
   CanopenNode canopen_node;
   CO_NODE *node;
+  SdoClient sdo_client{this};
+  SdoRequest csdo_targets[CO_CSDO_N] = {};
+  Discovery *discovery = nullptr;
 
   uint32_t node_id;
 
@@ -161,23 +249,55 @@ class CanopenComponent : public Component {
   uint16_t heartbeat_interval_ms = 0;
 
   uint8_t dirty_tpdo_mask = 0;
+  uint8_t tpdo_size[8] = {};  // number of mapped bytes
+  uint8_t tpdo_sync_period[8] = {};
+  // 0x1800 + N:03 (100us units) / :05 (ms), applied by TPDO service of canopen-stack
+  uint16_t tpdo_inhibit_time[8] = {};
+  uint16_t tpdo_event_timer[8] = {};
+  TpdoInhibit tpdo_inhibit[8] = {};
+  uint32_t tpdo_sent[8] = {};
+  uint32_t tpdo_suppressed[8] = {};
+  void tpdo_state_changed(int8_t tpdo_nr);
+  void tpdo_transmitted(int8_t tpdo_nr);
+  void flush_tpdos();
+  int8_t tpdo_number(uint32_t cob_id);
+  uint32_t sync_count = 0;
+  uint8_t pending_syncs = 0;
+  uint32_t sync_period_us = 0;
+  uint64_t next_sync_us = 0;
+  void sync_received();
+  void send_sync();
+  void process_sync();
 
   ESPPreferenceObject comm_state;
+  ESPPreferenceObject group_state;
+  // group membership entries: group id | entity index << 8 (entity 0 - whole node), 0 - unused
+  uint16_t group_table[CANOPEN_GROUP_N] = {};
+  bool is_group_member(uint8_t group, uint8_t entity_index);
+  void parse_od_writer_group(const uint8_t *data, uint8_t len);
   bool pdo_od_writer_enabled = true;
+  // nodes whose 0x500 + X frames are OD writer frames, one bit per node id (all by default)
+  uint32_t od_writer_senders[4] = {~0u, ~0u, ~0u, ~0u};
+  bool is_od_writer_sender(uint8_t sender) { return od_writer_senders[sender >> 5] & (1u << (sender & 31)); }
 
   void parse_od_writer_frame(CO_IF_FRM *frm);
+  void parse_od_writer_batch(const uint8_t *data, uint8_t len, bool broadcast);
+  // missing entity / command is not an error for broadcast and group commands
+  void write_entity_cmd(uint8_t entity_index, uint8_t cmd, const uint8_t *data, uint8_t size, bool broadcast);
 
  public:
   HbConsumerEventTrigger *on_hb_cons_event = {};  // TODO: change visibility
   CanStatus status;
-  std::map<uint32_t, std::function<void(void *, uint32_t)>> can_cmd_handlers;
+  // built in setup, indexed by entity id / command number
+  CmdTable cmd_handlers;
+  void dispatch_cmd(uint32_t key, void *buffer, uint32_t size);
 
 #ifdef USE_CANOPEN_OTA
   CanopenOTAComponent *ota;
   void set_ota(CanopenOTAComponent *ota) { this->ota = ota; }
 #endif
 
-  canbus::Canbus *canbus;
+  canbus::Canbus *canbus = nullptr;
   void set_canbus(canbus::Canbus *canbus);
 
   CanopenComponent(uint32_t node_id);
@@ -191,9 +311,21 @@ class CanopenComponent : public Component {
   void rpdo_map_append(uint8_t idx, uint32_t index, uint8_t sub, uint8_t size);
 
   void trig_tpdo(int8_t num = -1);
+  void set_sync_producer(uint32_t period_ms) { sync_period_us = period_ms * 1000; }
+  // time source of timer driver, SYNC producer and TPDO timing; must be set before setup()
+  void set_clock(MonotonicClock *clock) { this->clock = clock; }
 
   void setup_csdo(uint8_t num, uint8_t node_id, uint32_t tx_id, uint32_t rx_id);
   void csdo_recv(uint8_t num, uint32_t key, std::function<void(uint32_t, uint32_t)> cb);
+  SdoClient *get_sdo_client() { return &sdo_client; }
+  void set_sdo_client_defaults(uint32_t timeout_ms, uint8_t retries) {
+    sdo_client.default_timeout_ms = timeout_ms;
+    sdo_client.default_retries = retries;
+  }
+  // entity metadata is exposed only via descriptor domain (0x2FFF), without per-entity string objects
+  void set_compact_metadata(bool compact) { compact_metadata = compact; }
+  void set_discovery(bool enabled) { discovery = enabled ? new Discovery(this) : nullptr; }
+  Discovery *get_discovery() { return discovery; }
 
   void csdo_send_data(uint8_t num, uint32_t key, uint8_t *data, uint8_t len);
   void csdo_send_u8(uint8_t num, uint32_t key, uint8_t value) { csdo_send_data(num, key, (uint8_t *) (&value), 1); }
@@ -210,19 +342,26 @@ class CanopenComponent : public Component {
   void add_rpdo_entity_cmd(uint8_t idx, uint8_t entity_id, uint8_t cmd);
 
   void enable_pdo_od_writer(bool enable) { pdo_od_writer_enabled = enable; };
+  // restricts OD writer frames to given senders, other frames on their COB-IDs are not interpreted as commands
+  void set_od_writer_senders(const std::vector<uint8_t> &senders) {
+    memset(od_writer_senders, 0, sizeof(od_writer_senders));
+    for (auto sender : senders)
+      od_writer_senders[(sender & 0x7f) >> 5] |= 1u << (sender & 31);
+    rx_filter_dirty = true;
+  }
 
 #ifdef USE_SENSOR
   void add_entity(sensor::Sensor *sensor, uint32_t entity_id, TPDO tpdo, uint8_t size = 4, float min_val = 0,
-                  float max_val = 0) {
-    entities.push_back(new SensorEntity(sensor, entity_id, tpdo, size, min_val, max_val));
+                  float max_val = 0, float deadband = 0, bool only_on_change = false) {
+    entities.push_back(new SensorEntity(sensor, entity_id, tpdo, size, min_val, max_val, deadband, only_on_change));
   }
 
 #endif
 
 #ifdef USE_NUMBER
   void add_entity(esphome::number::Number *number, uint32_t entity_id, TPDO tpdo, uint8_t size = 4, float min_val = 0,
-                  float max_val = 0) {
-    entities.push_back(new NumberEntity(number, entity_id, tpdo, size, min_val, max_val));
+                  float max_val = 0, float deadband = 0, bool only_on_change = false) {
+    entities.push_back(new NumberEntity(number, entity_id, tpdo, size, min_val, max_val, deadband, only_on_change));
   }
 #endif
 
@@ -256,6 +395,9 @@ class CanopenComponent : public Component {
   }
 #endif
 
+  // strings are referenced, not copied, so they must live as long as the component
+  void od_add_metadata(uint32_t entity_id, uint32_t type, const char *name, const char *device_class,
+                       const char *unit, const char *state_class);
   void od_add_metadata(uint32_t entity_id, uint32_t type, const std::string &name, const std::string &device_class,
                        const std::string &unit, const std::string &state_class);
   void od_add_min_max_metadata(uint32_t entity_id, float min_value, float max_value);
@@ -272,6 +414,7 @@ class CanopenComponent : public Component {
   void add_entity_cmd(uint32_t entity_id, int8_t tpdo, Trigger<int32_t> *trigger);
 
   void od_set_string(uint32_t index, uint32_t sub, const char *value);
+  void od_set_static_string(uint32_t index, uint32_t sub, const char *value);
   void set_heartbeat_interval(uint16_t interval_ms);
   void setup_heartbeat_client(uint8_t subidx, uint8_t node_id, uint16_t timeout_ms);
   int16_t get_heartbeat_events(uint8_t node_id);
@@ -301,13 +444,33 @@ class CanopenComponent : public Component {
     return remote_entity_write_od(node_id, ENTITY_INDEX(entity_index) + 2, cmd + 1, &value, 4);
   }
 
+  // entity_index 0 - all entities assigned to group, otherwise given entity on all nodes assigned to group
+  bool send_entity_cmd(EntityGroup group, uint8_t entity_index, uint8_t value, uint8_t cmd = 0) {
+    return remote_group_write_od(group.id, entity_index, cmd, &value, 1);
+  }
+
+  bool send_entity_cmd(EntityGroup group, uint8_t entity_index, bool value, uint8_t cmd = 0) {
+    return send_entity_cmd(group, entity_index, (uint8_t) (value ? 1 : 0), cmd);
+  }
+
+  bool send_entity_cmd(EntityGroup group, uint8_t entity_index, uint16_t value, uint8_t cmd = 0) {
+    return remote_group_write_od(group.id, entity_index, cmd, &value, 2);
+  }
+
   bool remote_entity_write_od(uint8_t node_id, uint32_t index, uint8_t subindex, void *data, uint8_t size);
+  // sends 1-byte entity commands packed 3 per frame, node_id 0 - broadcast; returns number of frames sent
+  uint16_t remote_entity_write_od_batch(uint8_t node_id, std::vector<EntityCmd> cmds);
+  // group frame carries 1 or 2 value bytes (8 / 16-bit commands)
+  bool remote_group_write_od(uint8_t group, uint8_t entity_index, uint8_t cmd, void *data, uint8_t size);
+
+  void add_group(uint8_t group, uint8_t entity_index = 0);
 
   void on_frame(uint32_t can_id, bool rtr, const std::vector<uint8_t> &data);
   void store_comm_params();
   void reset_comm_params();
   void loop() override;
   bool get_can_status(CanStatus &status_info);
+  const BusStats &get_bus_stats() { return bus_stats; }
 };
 extern CanopenComponent *current_canopen;
 extern std::vector<CanopenComponent *> all_instances;
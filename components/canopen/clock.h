@@ -0,0 +1,31 @@
+#pragma once
+#include <cstdint>
+
+namespace esphome {
+namespace canopen {
+
+/* Extends 32-bit microsecond counter (wrapping every ~71 minutes) into
+ * monotonic 64-bit time. now_us() needs to be called at least once per
+ * counter period, which is guaranteed by calling it from loop().
+ */
+class MonotonicClock {
+  uint32_t prev_us = 0;
+  uint64_t high_us = 0;
+
+ protected:
+  virtual uint32_t raw_us();
+
+ public:
+  virtual ~MonotonicClock() = default;
+  uint64_t now_us() {
+    uint32_t us = raw_us();
+    if (us < prev_us) {
+      high_us += 1ULL << 32;
+    }
+    prev_us = us;
+    return high_us + us;
+  }
+};
+
+}  // namespace canopen
+}  // namespace esphome
@@ -0,0 +1,55 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "co_core.h"
+
+namespace esphome {
+namespace canopen {
+
+typedef std::function<void(void *, uint32_t)> CmdCallback;
+
+/* Entity command handlers, indexed directly by entity id and command sub-index
+ * of entity command object (0x2000 + entity_id * 16 + 2). Table is built in setup,
+ * lookup is two bounds-checked array accesses, without allocation.
+ */
+class CmdTable {
+  std::vector<std::vector<CmdCallback>> entities;
+
+  static bool decode(uint32_t key, uint32_t &entity_id, uint32_t &cmd) {
+    uint32_t index = CO_GET_IDX(key);
+    uint32_t sub = CO_GET_SUB(key);
+    if (index < 0x2000 || index >= 0x3000 || (index & 0xf) != 2 || !sub)
+      return false;
+    entity_id = (index - 0x2000) >> 4;
+    cmd = sub - 1;
+    return true;
+  }
+
+ public:
+  void set(uint32_t key, CmdCallback cb) {
+    uint32_t entity_id, cmd;
+    if (!decode(key, entity_id, cmd))
+      return;
+    if (entity_id >= entities.size())
+      entities.resize(entity_id + 1);
+    auto &cmds = entities[entity_id];
+    if (cmd >= cmds.size())
+      cmds.resize(cmd + 1);
+    cmds[cmd] = std::move(cb);
+  }
+
+  // returns nullptr if there is no handler for given key
+  const CmdCallback *find(uint32_t key) const {
+    uint32_t entity_id, cmd;
+    if (!decode(key, entity_id, cmd) || entity_id >= entities.size())
+      return nullptr;
+    auto &cmds = entities[entity_id];
+    if (cmd >= cmds.size() || !cmds[cmd])
+      return nullptr;
+    return &cmds[cmd];
+  }
+};
+
+}  // namespace canopen
+}  // namespace esphome
@@ -23,13 +23,7 @@ CO_ERR Cmd8Write(CO_OBJ *obj, CO_NODE *node, void *buffer, uint32_t size) {
 
   const CO_OBJ_TYPE *uint8 = CO_TUNSIGNED8;
   CO_ERR result = uint8->Write(obj, node, buffer, size);
-  uint32_t index = obj->Key & 0xffffff00;
-
-  auto cmd_handlers = ((CanopenNode *) node)->canopen->can_cmd_handlers;
-  auto it = cmd_handlers.find(index);
-  if (it != cmd_handlers.end()) {
-    it->second(buffer, size);
-  }
+  ((CanopenNode *) node)->canopen->dispatch_cmd(obj->Key, buffer, size);
   return result;
 }
 
@@ -55,13 +49,7 @@ CO_ERR Cmd16Write(CO_OBJ *obj, CO_NODE *node, void *buffer, uint32_t size) {
 
   const CO_OBJ_TYPE *uint32 = CO_TUNSIGNED16;
   CO_ERR result = uint32->Write(obj, node, buffer, size);
-  uint32_t index = obj->Key & 0xffffff00;
-
-  auto cmd_handlers = ((CanopenNode *) node)->canopen->can_cmd_handlers;
-  auto it = cmd_handlers.find(index);
-  if (it != cmd_handlers.end()) {
-    it->second(buffer, size);
-  }
+  ((CanopenNode *) node)->canopen->dispatch_cmd(obj->Key, buffer, size);
   return result;
 }
 
@@ -87,13 +75,7 @@ CO_ERR Cmd32Write(CO_OBJ *obj, CO_NODE *node, void *buffer, uint32_t size) {
 
   const CO_OBJ_TYPE *uint32 = CO_TUNSIGNED32;
   CO_ERR result = uint32->Write(obj, node, buffer, size);
-  uint32_t index = obj->Key & 0xffffff00;
-
-  auto cmd_handlers = ((CanopenNode *) node)->canopen->can_cmd_handlers;
-  auto it = cmd_handlers.find(index);
-  if (it != cmd_handlers.end()) {
-    it->second(buffer, size);
-  }
+  ((CanopenNode *) node)->canopen->dispatch_cmd(obj->Key, buffer, size);
   return result;
 }
 
@@ -0,0 +1,40 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+
+namespace esphome {
+namespace canopen {
+
+/* Set of accepted 11-bit COB-IDs, one bit per identifier (256 bytes).
+ * Filter accepts everything until first call to clear().
+ */
+class CobIdFilter {
+  static const uint32_t N = 2048;
+  uint32_t bits[N / 32];
+  bool enabled = false;
+
+ public:
+  void clear() {
+    memset(bits, 0, sizeof(bits));
+    enabled = true;
+  }
+
+  void add(uint32_t cob_id) {
+    if (cob_id < N)
+      bits[cob_id >> 5] |= 1u << (cob_id & 31);
+  }
+
+  void add_range(uint32_t first, uint32_t last) {
+    for (uint32_t cob_id = first; cob_id <= last; cob_id++)
+      add(cob_id);
+  }
+
+  bool accepts(uint32_t cob_id) const {
+    if (!enabled)
+      return true;
+    return cob_id < N && (bits[cob_id >> 5] & (1u << (cob_id & 31)));
+  }
+};
+
+}  // namespace canopen
+}  // namespace esphome
@@ -0,0 +1,144 @@
+#include <cstring>
+#include "descriptor.h"
+
+namespace esphome {
+namespace canopen {
+
+const size_t DESCRIPTOR_HEADER_SIZE = 6;
+const size_t DESCRIPTOR_ENTITY_SIZE = 10;
+const size_t DESCRIPTOR_MIN_MAX_SIZE = 8;
+
+template<typename T> void descriptor_put(std::vector<uint8_t> &buf, T value) {
+  auto ptr = (const uint8_t *) &value;
+  buf.insert(buf.end(), ptr, ptr + sizeof(value));
+}
+
+template<typename T> T descriptor_get(const uint8_t *ptr) {
+  T value;
+  memcpy(&value, ptr, sizeof(value));
+  return value;
+}
+
+uint8_t EntityDescriptorBuilder::intern(const char *str) {
+  if (!str || !*str)
+    return ENTITY_DESCRIPTOR_NO_STR;
+  for (size_t i = 0; i < strings.size(); i++) {
+    if (!strcmp(strings[i], str))
+      return i;
+  }
+  if (strings.size() >= ENTITY_DESCRIPTOR_NO_STR)
+    return ENTITY_DESCRIPTOR_NO_STR;
+  strings.push_back(str);
+  return strings.size() - 1;
+}
+
+EntityDescriptor *EntityDescriptorBuilder::find(uint8_t index) {
+  for (auto &entity : entities) {
+    if (entity.index == index)
+      return &entity;
+  }
+  return nullptr;
+}
+
+void EntityDescriptorBuilder::add(uint8_t index, uint32_t type, const char *name, const char *device_class,
+                                  const char *unit, const char *state_class) {
+  auto entity = find(index);
+  if (!entity) {
+    entities.emplace_back();
+    entity = &entities.back();
+    entity->index = index;
+  }
+  entity->type = type;
+  entity->str[0] = intern(name);
+  entity->str[1] = intern(device_class);
+  entity->str[2] = intern(unit);
+  entity->str[3] = intern(state_class);
+}
+
+void EntityDescriptorBuilder::set_min_max(uint8_t index, float min_value, float max_value) {
+  auto entity = find(index);
+  if (!entity)
+    return;
+  entity->flags |= ENTITY_DESCRIPTOR_HAS_MIN_MAX;
+  entity->min_value = min_value;
+  entity->max_value = max_value;
+}
+
+std::vector<uint8_t> EntityDescriptorBuilder::build() {
+  std::vector<uint8_t> buf;
+  buf.push_back(ENTITY_DESCRIPTOR_VERSION);
+  buf.push_back(entities.size());
+  buf.resize(DESCRIPTOR_HEADER_SIZE);  // size and string table offset are filled at the end
+  for (auto &entity : entities) {
+    buf.push_back(entity.index);
+    descriptor_put(buf, entity.type);
+    buf.push_back(entity.flags);
+    buf.insert(buf.end(), entity.str, entity.str + 4);
+    if (entity.flags & ENTITY_DESCRIPTOR_HAS_MIN_MAX) {
+      descriptor_put(buf, entity.min_value);
+      descriptor_put(buf, entity.max_value);
+    }
+  }
+  uint16_t strings_offset = buf.size();
+  buf.push_back(strings.size());
+  for (auto str : strings)
+    buf.insert(buf.end(), str, str + strlen(str) + 1);
+  uint16_t size = buf.size();
+  memcpy(&buf[2], &size, sizeof(size));
+  memcpy(&buf[4], &strings_offset, sizeof(strings_offset));
+
+  entities = {};
+  strings = {};
+  buf.shrink_to_fit();
+  return buf;
+}
+
+bool parse_entity_descriptor(const uint8_t *data, size_t size, std::vector<ParsedEntityDescriptor> &entities) {
+  if (size < DESCRIPTOR_HEADER_SIZE || data[0] != ENTITY_DESCRIPTOR_VERSION)
+    return false;
+  uint8_t count = data[1];
+  uint16_t total_size = descriptor_get<uint16_t>(data + 2);
+  uint16_t strings_offset = descriptor_get<uint16_t>(data + 4);
+  if (total_size > size || strings_offset >= total_size)
+    return false;
+
+  std::vector<std::string> strings;
+  const uint8_t *ptr = data + strings_offset + 1;
+  const uint8_t *end = data + total_size;
+  for (uint8_t i = 0; i < data[strings_offset]; i++) {
+    auto len = strnlen((const char *) ptr, end - ptr);
+    if (ptr + len >= end)
+      return false;
+    strings.emplace_back((const char *) ptr, len);
+    ptr += len + 1;
+  }
+
+  ptr = data + DESCRIPTOR_HEADER_SIZE;
+  end = data + strings_offset;
+  for (uint8_t i = 0; i < count; i++) {
+    if (ptr + DESCRIPTOR_ENTITY_SIZE > end)
+      return false;
+    ParsedEntityDescriptor entity;
+    entity.index = ptr[0];
+    entity.type = descriptor_get<uint32_t>(ptr + 1);
+    uint8_t flags = ptr[5];
+    for (int s = 0; s < 4; s++) {
+      if (ptr[6 + s] < strings.size())
+        entity.str[s] = strings[ptr[6 + s]];
+    }
+    ptr += DESCRIPTOR_ENTITY_SIZE;
+    entity.has_min_max = flags & ENTITY_DESCRIPTOR_HAS_MIN_MAX;
+    if (entity.has_min_max) {
+      if (ptr + DESCRIPTOR_MIN_MAX_SIZE > end)
+        return false;
+      entity.min_value = descriptor_get<float>(ptr);
+      entity.max_value = descriptor_get<float>(ptr + 4);
+      ptr += DESCRIPTOR_MIN_MAX_SIZE;
+    }
+    entities.push_back(std::move(entity));
+  }
+  return true;
+}
+
+}  // namespace canopen
+}  // namespace esphome
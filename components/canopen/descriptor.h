@@ -0,0 +1,60 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace esphome {
+namespace canopen {
+
+const uint8_t ENTITY_DESCRIPTOR_VERSION = 1;
+const uint8_t ENTITY_DESCRIPTOR_NO_STR = 0xff;
+const uint8_t ENTITY_DESCRIPTOR_HAS_MIN_MAX = 1;
+
+/* Packed description of all node entities, exposed as read-only domain (0x2FFF:02), so it
+ * can be fetched with single SDO transfer. All values are little endian:
+ *
+ *   header:  u8 version, u8 entity count, u16 total size, u16 string table offset
+ *   entity:  u8 entity index, u32 type (incl. version / caps bits), u8 flags,
+ *            u8 name, device class, unit, state class - string table indices (0xff - none),
+ *            f32 min, f32 max (only if flags & ENTITY_DESCRIPTOR_HAS_MIN_MAX)
+ *   strings: u8 count, zero terminated strings, each one stored only once
+ */
+struct EntityDescriptor {
+  uint8_t index = 0;
+  uint32_t type = 0;
+  uint8_t flags = 0;
+  uint8_t str[4] = {ENTITY_DESCRIPTOR_NO_STR, ENTITY_DESCRIPTOR_NO_STR, ENTITY_DESCRIPTOR_NO_STR,
+                    ENTITY_DESCRIPTOR_NO_STR};  // name, device class, unit, state class
+  float min_value = 0;
+  float max_value = 0;
+};
+
+class EntityDescriptorBuilder {
+  std::vector<EntityDescriptor> entities;
+  std::vector<const char *> strings;
+
+  uint8_t intern(const char *str);
+  EntityDescriptor *find(uint8_t index);
+
+ public:
+  void add(uint8_t index, uint32_t type, const char *name, const char *device_class, const char *unit,
+           const char *state_class);
+  void set_min_max(uint8_t index, float min_value, float max_value);
+  // builds descriptor blob and releases builder memory
+  std::vector<uint8_t> build();
+};
+
+struct ParsedEntityDescriptor {
+  uint8_t index = 0;
+  uint32_t type = 0;
+  std::string str[4];
+  bool has_min_max = false;
+  float min_value = 0;
+  float max_value = 0;
+};
+
+// returns false if descriptor is malformed or has unsupported version
+bool parse_entity_descriptor(const uint8_t *data, size_t size, std::vector<ParsedEntityDescriptor> &entities);
+
+}  // namespace canopen
+}  // namespace esphome
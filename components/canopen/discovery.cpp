@@ -0,0 +1,162 @@
+#include "esphome.h"
+#include "canopen.h"
+#include "discovery.h"
+
+namespace esphome {
+namespace canopen {
+
+const uint32_t DISCOVERY_STR_MAX = 64;
+const uint32_t DISCOVERY_DESCRIPTOR_MAX = 4096;
+
+std::string discovery_str(const std::vector<uint8_t> &data) {
+  return std::string((const char *) data.data(), strnlen((const char *) data.data(), data.size()));
+}
+
+uint32_t discovery_u32(const std::vector<uint8_t> &data) {
+  uint32_t value = 0;
+  memcpy(&value, data.data(), std::min(data.size(), sizeof(value)));
+  return value;
+}
+
+void Discovery::upload(uint8_t node_id, uint16_t index, uint8_t sub, uint32_t size,
+                       std::function<void(const std::vector<uint8_t> &data)> cb, std::function<void()> on_abort) {
+  probes[node_id].outstanding++;
+  canopen->get_sdo_client()->upload(
+      node_id, CO_DEV(index, sub), size, [this, cb, on_abort](SdoRequest &req, uint32_t code) {
+        // missing objects are expected (optional metadata), they are just skipped
+        if (!code)
+          cb(req.data);
+        else if (code == SDO_ABORT_TIMEOUT)
+          probes[req.node_id].timed_out = true;
+        else if (on_abort)
+          on_abort();
+        request_done(req.node_id);
+      });
+}
+
+void Discovery::request_done(uint8_t node_id) {
+  auto &probe = probes[node_id];
+  if (--probe.outstanding)
+    return;
+  if (!probe.fetching_entities) {
+    identity_done(node_id);
+    return;
+  }
+  probe.node.complete = !probe.timed_out;
+  ESP_LOGI(TAG, "discovery: node %02x has %d entities%s", node_id, probe.node.entities.size(),
+           probe.timed_out ? " (incomplete)" : "");
+  auto &node = nodes[node_id] = std::move(probe.node);
+  probes.erase(node_id);
+  discovered_callback.call(node_id, node);
+}
+
+void Discovery::on_heartbeat(uint8_t node_id, uint8_t state) {
+  if (probes.count(node_id))
+    return;
+  // state 0 - boot-up message, node may have new firmware
+  auto cached = nodes.find(node_id);
+  if (cached != nodes.end() && cached->second.complete && state != 0)
+    return;
+  probe(node_id);
+}
+
+void Discovery::probe(uint8_t node_id) {
+  ESP_LOGD(TAG, "discovery: probing node %02x", node_id);
+  probes[node_id] = {};
+  for (uint8_t sub = 1; sub <= 4; sub++) {
+    upload(node_id, 0x1018, sub, 4, [this, node_id, sub](const std::vector<uint8_t> &data) {
+      probes[node_id].node.identity[sub - 1] = discovery_u32(data);
+    });
+  }
+  upload(node_id, 0x100A, 0, DISCOVERY_STR_MAX,
+         [this, node_id](const std::vector<uint8_t> &data) { probes[node_id].node.version = discovery_str(data); });
+}
+
+void Discovery::identity_done(uint8_t node_id) {
+  auto &probe = probes[node_id];
+  auto cached = nodes.find(node_id);
+  if (!probe.timed_out && cached != nodes.end() && cached->second.complete &&
+      cached->second.version == probe.node.version &&
+      !memcmp(cached->second.identity, probe.node.identity, sizeof(probe.node.identity))) {
+    ESP_LOGD(TAG, "discovery: node %02x unchanged, using cached entities", node_id);
+    probes.erase(node_id);
+    return;
+  }
+  fetch_entities(node_id);
+}
+
+void Discovery::fetch_entities(uint8_t node_id) {
+  ESP_LOGD(TAG, "discovery: fetching entities of node %02x", node_id);
+  probes[node_id].fetching_entities = true;
+  auto fallback = [this, node_id]() { fetch_entity_table(node_id); };
+  // 0x2FFF:1 - entity descriptor size, 0x2FFF:2 - descriptor
+  upload(
+      node_id, 0x2FFF, 1, 4,
+      [this, node_id, fallback](const std::vector<uint8_t> &data) {
+        uint32_t size = discovery_u32(data);
+        if (!size || size > DISCOVERY_DESCRIPTOR_MAX) {
+          fallback();
+          return;
+        }
+        upload(
+            node_id, 0x2FFF, 2, size,
+            [this, node_id, fallback](const std::vector<uint8_t> &data) {
+              if (!parse_descriptor(node_id, data))
+                fallback();
+            },
+            fallback);
+      },
+      fallback);
+}
+
+bool Discovery::parse_descriptor(uint8_t node_id, const std::vector<uint8_t> &data) {
+  std::vector<ParsedEntityDescriptor> parsed;
+  if (!parse_entity_descriptor(data.data(), data.size(), parsed)) {
+    ESP_LOGW(TAG, "discovery: invalid entity descriptor of node %02x", node_id);
+    return false;
+  }
+  auto &entities = probes[node_id].node.entities;
+  for (auto &p : parsed) {
+    entities.push_back({p.index, p.type, p.str[0], p.str[1], p.str[2], p.str[3]});
+    if (p.has_min_max) {
+      entities.back().min_value = p.min_value;
+      entities.back().max_value = p.max_value;
+    }
+  }
+  return true;
+}
+
+void Discovery::fetch_entity_table(uint8_t node_id) {
+  // 0x2001:0 - number of entity type entries
+  upload(node_id, 0x2001, 0, 1, [this, node_id](const std::vector<uint8_t> &data) {
+    for (int entity_index = 1; entity_index <= data[0]; entity_index++)
+      fetch_entity(node_id, entity_index);
+  });
+}
+
+void Discovery::fetch_entity(uint8_t node_id, uint8_t entity_index) {
+  upload(node_id, 0x2001, entity_index, 4, [this, node_id, entity_index](const std::vector<uint8_t> &data) {
+    auto &entities = probes[node_id].node.entities;
+    entities.push_back({entity_index, discovery_u32(data)});
+    uint16_t index = ENTITY_INDEX(entity_index);
+    size_t pos = entities.size() - 1;
+    const uint8_t subs[] = {ENTITY_INDEX_NAME, ENTITY_INDEX_DEVICE_CLASS, ENTITY_INDEX_UNIT, ENTITY_INDEX_STATE_CLASS};
+    for (auto sub : subs) {
+      upload(node_id, index, sub, DISCOVERY_STR_MAX, [this, node_id, pos, sub](const std::vector<uint8_t> &data) {
+        auto &entity = probes[node_id].node.entities[pos];
+        auto value = discovery_str(data);
+        if (sub == ENTITY_INDEX_NAME)
+          entity.name = value;
+        else if (sub == ENTITY_INDEX_DEVICE_CLASS)
+          entity.device_class = value;
+        else if (sub == ENTITY_INDEX_UNIT)
+          entity.unit = value;
+        else
+          entity.state_class = value;
+      });
+    }
+  });
+}
+
+}  // namespace canopen
+}  // namespace esphome
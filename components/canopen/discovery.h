@@ -0,0 +1,68 @@
+#pragma once
+#include <cmath>
+#include <map>
+#include <string>
+#include <vector>
+#include "esphome/core/helpers.h"
+
+namespace esphome {
+namespace canopen {
+
+class CanopenComponent;
+
+struct DiscoveredEntity {
+  uint8_t index;
+  uint32_t type;
+  std::string name;
+  std::string device_class;
+  std::string unit;
+  std::string state_class;
+  float min_value = NAN;  // sensors / numbers, available only from entity descriptor
+  float max_value = NAN;
+};
+
+struct DiscoveredNode {
+  uint32_t identity[4];  // 0x1018: vendor id, product code, revision, serial number
+  std::string version;   // 0x100A
+  std::vector<DiscoveredEntity> entities;
+  bool complete;  // false if some requests timed out, entities will be fetched again on next heartbeat
+};
+
+/* Learns entities of other nodes: nodes are detected by their heartbeats, on first heartbeat
+ * (or boot-up message) identity and sw version are read, entity table is (re)fetched only if
+ * they differ from cached ones. Entity descriptor domain (0x2FFF) is used when node provides it,
+ * otherwise entity types and metadata strings are read one by one.
+ */
+class Discovery {
+  CanopenComponent *canopen;
+  std::map<uint8_t, DiscoveredNode> nodes;
+  struct Probe {
+    DiscoveredNode node;
+    uint16_t outstanding;  // number of SDO requests in progress
+    bool fetching_entities;
+    bool timed_out;
+  };
+  std::map<uint8_t, Probe> probes;
+  CallbackManager<void(uint8_t, const DiscoveredNode &)> discovered_callback;
+
+  void upload(uint8_t node_id, uint16_t index, uint8_t sub, uint32_t size,
+              std::function<void(const std::vector<uint8_t> &data)> cb, std::function<void()> on_abort = nullptr);
+  void request_done(uint8_t node_id);
+  void probe(uint8_t node_id);
+  void identity_done(uint8_t node_id);
+  void fetch_entities(uint8_t node_id);
+  void fetch_entity_table(uint8_t node_id);
+  bool parse_descriptor(uint8_t node_id, const std::vector<uint8_t> &data);
+  void fetch_entity(uint8_t node_id, uint8_t entity_index);
+
+ public:
+  explicit Discovery(CanopenComponent *canopen) : canopen(canopen) {}
+  void on_heartbeat(uint8_t node_id, uint8_t state);
+  const std::map<uint8_t, DiscoveredNode> &get_nodes() const { return nodes; }
+  void add_on_discovered_callback(std::function<void(uint8_t, const DiscoveredNode &)> &&cb) {
+    discovered_callback.add(std::move(cb));
+  }
+};
+
+}  // namespace canopen
+}  // namespace esphome
@@ -12,26 +12,19 @@ namespace canopen {
 const char *TAG = "can_driver";
 const char *TAG_TM = "timer_driver";
 
-
-static uint32_t prev_us = 0;
-static uint64_t total_us = 0;
-
-uint64_t get_micros_u64() {
-    uint32_t us = esphome::micros();
-    if(prev_us > us) {
-      // overflow
-      total_us += 0x100000000;
-    }
-    prev_us = us;
-    return total_us | us;
-}
+uint32_t MonotonicClock::raw_us() { return esphome::micros(); }
 
 void DrvCanInit(void) { ESP_LOGI(TAG, "DrvCanInit"); }
 
 void DrvCanEnable(uint32_t baudrate) { ESP_LOGI(TAG, "DrvCanEnable baudrate: %ld", baudrate); }
 
+static_assert(sizeof(CO_IF_FRM::Data) == CAN_MAX_DLC, "unexpected CO_IF_FRM payload size");
+
 char *can_data_str(uint8_t *data, uint8_t len) {
-  static char buf[3 * 8 + 1] = "";
+  static char buf[3 * CAN_MAX_DLC + 1] = "";
+  if (len > CAN_MAX_DLC)
+    len = CAN_MAX_DLC;
+  buf[0] = 0;
   for (int i = 0; i < len; i++) {
     sprintf(buf + i * 3, " %02x", data[i]);
   }
@@ -45,15 +38,21 @@ int16_t DrvCanSend(CO_IF_FRM *frm) {
   }
   ESP_LOGV(TAG, "DrvCanSend id: %03lx, len: %d, data:%s", frm->Identifier, frm->DLC, can_data_str(frm->Data, frm->DLC));
 
+  current_canopen->bus_stats.tx_frames++;
+  int8_t tpdo_nr = current_canopen->tpdo_number(frm->Identifier);
+  if (tpdo_nr >= 0)
+    current_canopen->tpdo_transmitted(tpdo_nr);
+
   for (auto it = all_instances.begin(); it < all_instances.end(); it++)
     if (*it != current_canopen) {
       // loopback to peer node
-      (*it)->recv_frames.push_back(*frm);
+      (*it)->push_frame(*frm);
     }
 
-  std::vector<uint8_t> data(frm->Data, frm->Data + frm->DLC);
-
   if (current_canopen->canbus) {
+    // capacity is reserved in constructor, so assign() doesn't allocate
+    auto &data = current_canopen->tx_data;
+    data.assign(frm->Data, frm->Data + frm->DLC);
     current_canopen->canbus->send_data(frm->Identifier, false, data);
   }
   return 0;
@@ -64,10 +63,7 @@ int16_t DrvCanRead(CO_IF_FRM *frm) {
     ESP_LOGW(TAG, "no current canopen instance set");
     return 0;
   }
-  if (current_canopen->recv_frames.size() > 0) {
-    auto it = current_canopen->recv_frames.begin();
-    *frm = *it;
-    current_canopen->recv_frames.erase(it);
+  if (current_canopen->read_frame(frm)) {
     ESP_LOGV(TAG, "DrvCanRead id: %03lx, len: %d, data:%s", frm->Identifier, frm->DLC,
              can_data_str(frm->Data, frm->DLC));
     return sizeof(CO_IF_FRM);
@@ -109,11 +105,7 @@ uint8_t DrvTimerUpdate(void) {
     return 0;
   }
 
-  uint64_t micros = get_micros_u64();
-  int64_t dt = current_canopen->next_timer_us - micros;
-
-  ESP_LOGVV(TAG_TM, "DrvTimerUpdate node_id: %d, %lld", current_canopen->node_id, dt);
-  return dt > 0 ? 0 : 1;
+  return current_canopen->timer_expired(current_canopen->clock->now_us()) ? 1 : 0;
 }
 
 uint32_t DrvTimerDelay(void) {
@@ -121,7 +113,7 @@ uint32_t DrvTimerDelay(void) {
     ESP_LOGW(TAG_TM, "no current canopen instance set");
     return 0;
   }
-  uint64_t micros = get_micros_u64();
+  uint64_t micros = current_canopen->clock->now_us();
   int64_t dt = current_canopen->next_timer_us - micros;
   ESP_LOGV(TAG_TM, "DrvTimerDelay node_id: %ld delay: %lld", current_canopen->node_id, dt);
 
@@ -138,7 +130,7 @@ void DrvTimerReload(uint32_t reload) {
   /* configure the next hardware timer interrupt */
   ESP_LOGV(TAG_TM, "DrvTimerReload node_id: %ld, %ld", current_canopen->node_id, reload);
 
-  current_canopen->next_timer_us = get_micros_u64() + reload;
+  current_canopen->next_timer_us = current_canopen->clock->now_us() + reload;
 }
 
 void DrvTimerStop(void) {
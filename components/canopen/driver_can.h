@@ -2,6 +2,9 @@
 
 namespace esphome {
 namespace canopen {
+// classic CAN payload size, CO_IF_FRM and ESPHome canbus are limited to it
+const uint8_t CAN_MAX_DLC = 8;
+
 void DrvCanInit(void);
 void DrvCanEnable(uint32_t baudrate);
 int16_t DrvCanSend(CO_IF_FRM *frm);
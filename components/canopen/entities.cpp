@@ -28,18 +28,41 @@ uint32_t color_temp_to_wire(float value) { return scale_to_wire(value, 100.0, 10
 
 float color_temp_from_wire(uint32_t value) { return scale_from_wire(value, 100.0, 1000.0, 255); }
 
+uint32_t size_to_max_int(uint8_t size) { return size == 1 ? 255 : 65535; }
+
+bool ChangeFilter::accept(uint32_t value, uint8_t size) {
+  if (value == last_value && (only_on_change || deadband > 0))
+    return false;
+  if (deadband > 0) {
+    float delta;
+    if (size == 4) {
+      float a, b;
+      memcpy(&a, &value, sizeof(a));
+      memcpy(&b, &last_value, sizeof(b));
+      delta = fabsf(a - b);  // NaN if any of values is NaN
+    } else {
+      uint32_t nan = size_to_max_int(size);
+      delta = (value == nan || last_value == nan) ? NAN : fabsf((float) value - (float) last_value);
+    }
+    if (delta < deadband)
+      return false;
+  }
+  last_value = value;
+  return true;
+}
+
 #ifdef USE_SENSOR
 void SensorEntity::setup(CanopenComponent *canopen) {
 
   char device_class_buf[MAX_DEVICE_CLASS_LENGTH];
   const char *device_class_tmp = sensor->get_device_class_to(device_class_buf);
-  std::string device_class(device_class_tmp ? device_class_tmp : "");
+  const char *device_class = device_class_tmp && *device_class_tmp ? od_copy_string(device_class_tmp) : "";
 
   canopen->od_add_metadata(entity_id,
                            size == 1   ? ENTITY_TYPE_SENSOR_UINT8
                            : size == 2 ? ENTITY_TYPE_SENSOR_UINT16
                                        : ENTITY_TYPE_SENSOR,
-                           sensor->get_name(), device_class, sensor->get_unit_of_measurement_ref(),
+                           sensor->get_name().c_str(), device_class, sensor->get_unit_of_measurement_ref().c_str(),
                            (char *) esphome::sensor::state_class_to_string(sensor->get_state_class()));
   canopen->od_add_min_max_metadata(entity_id, min_val, max_val);
   uint32_t state_key;
@@ -74,9 +97,14 @@ void SensorEntity::setup(CanopenComponent *canopen) {
   float state = NAN;
   auto casted_state = to_wire(state);
   state_key = canopen->od_add_state(entity_id, type, &casted_state, size, tpdo);
+  change_filter.last_value = casted_state;
+  if (size != 4 && max_val > min_val)
+    change_filter.deadband *= (size_to_max_int(size) - 1) / (max_val - min_val);
 
   sensor->add_on_state_callback([=, this](float value) {
     auto casted_state = to_wire(value);
+    if (!change_filter.accept(casted_state, size))
+      return;
     od_set_state(canopen, state_key, &casted_state, size);
   });
   canopen->od_add_cmd(
@@ -92,7 +120,7 @@ void NumberEntity::setup(CanopenComponent *canopen) {
                            size == 1   ? ENTITY_TYPE_NUMBER_UINT8
                            : size == 2 ? ENTITY_TYPE_NUMBER_UINT16
                                        : ENTITY_TYPE_NUMBER,
-                           number->get_name(), "", "", "");
+                           number->get_name().c_str(), "", "", "");
 
   canopen->od_add_min_max_metadata(entity_id, min_val, max_val);
   uint32_t state_key;
@@ -126,8 +154,14 @@ void NumberEntity::setup(CanopenComponent *canopen) {
   }
   auto casted_state = to_wire(state);
   state_key = canopen->od_add_state(entity_id, type, &casted_state, size, tpdo);
-  number->add_on_state_callback([=](float value) {
+  change_filter.last_value = casted_state;
+  if (size != 4 && max_val > min_val)
+    change_filter.deadband *= (size_to_max_int(size) - 1) / (max_val - min_val);
+
+  number->add_on_state_callback([=, this](float value) {
     auto casted_state = to_wire(value);
+    if (!change_filter.accept(casted_state, size))
+      return;
     od_set_state(canopen, state_key, &casted_state, size);
   });
   canopen->od_add_cmd(
@@ -141,9 +175,9 @@ void BinarySensorEntity::setup(CanopenComponent *canopen) {
 
   char device_class_buf[MAX_DEVICE_CLASS_LENGTH];
   const char *device_class_tmp = sensor->get_device_class_to(device_class_buf);
-  std::string device_class(device_class_tmp ? device_class_tmp : "");
+  const char *device_class = device_class_tmp && *device_class_tmp ? od_copy_string(device_class_tmp) : "";
 
-  canopen->od_add_metadata(entity_id, ENTITY_TYPE_BINARY_SENSOR, sensor->get_name(), device_class, "",
+  canopen->od_add_metadata(entity_id, ENTITY_TYPE_BINARY_SENSOR, sensor->get_name().c_str(), device_class, "",
                            "");
   auto state_key = canopen->od_add_state(entity_id, CO_TUNSIGNED8, &sensor->state, 1, tpdo);
   sensor->add_on_state_callback([=, this](bool x) { od_set_state(canopen, state_key, &x, 1); });
@@ -158,10 +192,10 @@ void SwitchEntity::setup(CanopenComponent *canopen) {
 
   char device_class_buf[MAX_DEVICE_CLASS_LENGTH];
   const char *device_class_tmp = switch_->get_device_class_to(device_class_buf);
-  std::string device_class(device_class_tmp ? device_class_tmp : "");
+  const char *device_class = device_class_tmp && *device_class_tmp ? od_copy_string(device_class_tmp) : "";
 
   auto state = switch_->get_initial_state_with_restore_mode().value_or(false);
-  canopen->od_add_metadata(entity_id, ENTITY_TYPE_SWITCH, switch_->get_name(), device_class, "", "");
+  canopen->od_add_metadata(entity_id, ENTITY_TYPE_SWITCH, switch_->get_name().c_str(), device_class, "", "");
   auto state_key = canopen->od_add_state(entity_id, CO_TUNSIGNED8, &state, 1, tpdo);
   switch_->add_on_state_callback([=](bool value) { od_set_state(canopen, state_key, &value, 1); });
   canopen->od_add_cmd(entity_id, [=](void *buffer, uint32_t size) {
@@ -216,7 +250,8 @@ void LightStateEntity::setup(CanopenComponent *canopen) {
     caps |= 4;
   }
 
-  canopen->od_add_metadata(entity_id, ENTITY_TYPE_LIGHT | (version << 8) | (caps << 16), light->get_name(), "", "", "");
+  canopen->od_add_metadata(entity_id, ENTITY_TYPE_LIGHT | (version << 8) | (caps << 16), light->get_name().c_str(), "",
+                           "", "");
 
   if (caps & (2 | 4)) {
     brightness_key = canopen->od_add_state(entity_id, CO_TUNSIGNED8, &brightness, 1, tpdo);
@@ -276,9 +311,9 @@ void CoverEntity::setup(CanopenComponent *canopen) {
 
   char device_class_buf[MAX_DEVICE_CLASS_LENGTH];
   const char *device_class_tmp = cover->get_device_class_to(device_class_buf);
-  std::string device_class(device_class_tmp ? device_class_tmp : "");
+  const char *device_class = device_class_tmp && *device_class_tmp ? od_copy_string(device_class_tmp) : "";
 
-  canopen->od_add_metadata(entity_id, ENTITY_TYPE_COVER | (version << 8) | (caps << 16), cover->get_name(),
+  canopen->od_add_metadata(entity_id, ENTITY_TYPE_COVER | (version << 8) | (caps << 16), cover->get_name().c_str(),
                            device_class, "", "");
   auto state_key = canopen->od_add_state(entity_id, CO_TUNSIGNED8, &state, 1, tpdo);
 
@@ -338,7 +373,7 @@ void CoverEntity::setup(CanopenComponent *canopen) {
 
 #ifdef USE_ALARM_CONTROL_PANEL
 void AlarmEntity::setup(CanopenComponent *canopen) {
-  canopen->od_add_metadata(entity_id, ENTITY_TYPE_ALARM, alarm->get_name(), "", "", "");
+  canopen->od_add_metadata(entity_id, ENTITY_TYPE_ALARM, alarm->get_name().c_str(), "", "", "");
   auto state = alarm->get_state();
   ESP_LOGI(TAG, "Alarm initial state: %d", state);
 
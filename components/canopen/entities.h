@@ -58,10 +58,21 @@ namespace canopen {
 struct TPDO {
   int number;
   bool is_async;
+  uint8_t sync;  // CiA 301 synchronous transmission type (1..240), 0 - event driven
+  uint16_t inhibit_time;  // min time between transmissions, in 100us units
+  uint16_t event_timer;   // max time between transmissions, in ms
 };
 
 class CanopenComponent;
 
+// suppresses state updates which don't change wire value by more than deadband
+struct ChangeFilter {
+  float deadband = 0;  // in wire units (float value for 4-byte entities)
+  bool only_on_change = false;
+  uint32_t last_value = 0;
+  bool accept(uint32_t value, uint8_t size);
+};
+
 class BaseCanopenEntity {
  public:
   uint32_t entity_id;
@@ -81,13 +92,16 @@ class SensorEntity : public BaseCanopenEntity {
   uint8_t size;
   float min_val;
   float max_val;
+  ChangeFilter change_filter;
   SensorEntity(sensor::Sensor *sensor, uint32_t entity_id, TPDO tpdo, uint8_t size = 4, float min_val = 0,
-               float max_val = 0)
+               float max_val = 0, float deadband = 0, bool only_on_change = false)
       : BaseCanopenEntity(entity_id, tpdo) {
     this->sensor = sensor;
     this->size = size;
     this->min_val = min_val;
     this->max_val = max_val;
+    this->change_filter.deadband = deadband;
+    this->change_filter.only_on_change = only_on_change;
   }
   void setup(CanopenComponent *canopen) override;
 };
@@ -100,13 +114,16 @@ class NumberEntity : public BaseCanopenEntity {
   uint8_t size;
   float min_val;
   float max_val;
+  ChangeFilter change_filter;
   NumberEntity(esphome::number::Number *number, uint32_t entity_id, TPDO tpdo, uint8_t size = 4, float min_val = 0,
-               float max_val = 0)
+               float max_val = 0, float deadband = 0, bool only_on_change = false)
       : BaseCanopenEntity(entity_id, tpdo) {
     this->number = number;
     this->size = size;
     this->min_val = min_val;
     this->max_val = max_val;
+    this->change_filter.deadband = deadband;
+    this->change_filter.only_on_change = only_on_change;
   }
   void setup(CanopenComponent *canopen) override;
 };
@@ -5,6 +5,9 @@
 
 #define TAG "fw"
 
+// whole SDO segment must fit in OTA buffer, it is either buffered or rejected
+static_assert(CANOPEN_OTA_BUF_SIZE >= CO_SDO_BUF_BYTE, "CANOPEN_OTA_BUF_SIZE must not be smaller than CO_SDO_BUF_BYTE");
+
 namespace esphome {
 namespace canopen {
 
@@ -19,16 +22,114 @@ CO_ERR FwCtrlWrite(CO_OBJ *obj, CO_NODE *node, void *buffer, uint32_t size) {
   CO_ERR result = CO_ERR_TYPE_WR;
   result = CO_ERR_NONE;
 
-  if (command == 0xdeadbeef) {
+  if (command == FW_CTRL_ERASE) {
     ESP_LOGI(TAG, "Erasing flash");
 
     /* erase your firmware region in FLASH here */
 
     result = CO_ERR_NONE;
+  } else if (command == FW_CTRL_RESUME) {
+    Firmware *firmware = &FirmwareObj;
+    auto ota = ((CanopenNode *) node)->canopen->ota;
+    if (!ota || !ota->in_progress()) {
+      ESP_LOGW(TAG, "no interrupted firmware upload to resume");
+      return CO_ERR_OBJ_WRITE;
+    }
+    firmware->multicast = false;
+    firmware->resume = true;
+    firmware->resume_offset = firmware->domain.Offset;
+    ESP_LOGI(TAG, "resuming firmware upload at offset %ld, crc: %08lx", firmware->resume_offset, firmware->crc);
+  } else if (command == FW_CTRL_MULTICAST) {
+    Firmware *firmware = &FirmwareObj;
+    auto ota = ((CanopenNode *) node)->canopen->ota;
+    if (!ota || !firmware->size || !firmware->multicast_size) {
+      ESP_LOGW(TAG, "can't start multicast firmware upload, ota not enabled or size not set");
+      return CO_ERR_OBJ_WRITE;
+    }
+    if (ota->begin(firmware->size)) {
+      ESP_LOGE(TAG, "can't start OTA");
+      return CO_ERR_OBJ_WRITE;
+    }
+    firmware->domain.Offset = 0;
+    fw_reset_crc(firmware);
+    firmware->ota_size = firmware->multicast_size;
+    firmware->resume = false;
+    firmware->multicast_missed = 0;
+    firmware->multicast = true;
+    ESP_LOGI(TAG, "multicast firmware upload started, %ld bytes", firmware->ota_size);
   }
   return result;
 }
 
+void fw_multicast_frame(CanopenComponent *canopen, const CO_IF_FRM *frm) {
+  Firmware *firmware = &FirmwareObj;
+  if (!firmware->multicast || frm->DLC <= FW_MULTICAST_SEQ_SIZE)
+    return;
+  uint32_t seq = frm->Data[0] | (frm->Data[1] << 8) | (frm->Data[2] << 16);
+  uint32_t start = seq * FW_MULTICAST_CHUNK_SIZE;
+  uint32_t end = start + frm->DLC - FW_MULTICAST_SEQ_SIZE;
+  uint32_t offset = firmware->domain.Offset;
+  if (offset < start) {
+    // data must be written in order, everything after first gap is fetched again (resume / next pass)
+    if (!firmware->multicast_missed++)
+      ESP_LOGW(TAG, "multicast firmware upload: missing data at offset %ld", offset);
+    return;
+  }
+  if (offset >= end)
+    return;
+  uint8_t data[FW_MULTICAST_CHUNK_SIZE];
+  memcpy(data, frm->Data + FW_MULTICAST_SEQ_SIZE + (offset - start), end - offset);
+  auto err = fw_image_append(firmware, canopen, data, end - offset);
+  if (err != CO_ERR_NONE && canopen->ota->in_progress()) {
+    // rejected while flash is busy, fetched again like any other missing data
+    firmware->multicast_missed++;
+  } else if (err != CO_ERR_NONE || firmware->domain.Offset >= firmware->ota_size) {
+    firmware->multicast = false;
+  }
+}
+
+uint32_t fw_crc32(uint32_t crc, const uint8_t *data, uint32_t size) {
+  crc = ~crc;
+  while (size--) {
+    crc ^= *data++;
+    for (int i = 0; i < 8; i++)
+      crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+  }
+  return ~crc;
+}
+
+uint32_t FirmwareChunkCrc[FW_CHUNK_CRC_N];
+CO_OBJ_DOM FirmwareChunkCrcObj = {0, 0, (uint8_t *) FirmwareChunkCrc};
+
+void fw_reset_crc(Firmware *firmware) {
+  firmware->crc = 0;
+  firmware->chunk_crc = 0;
+  firmware->chunks = 0;
+  FirmwareChunkCrcObj.Size = 0;
+}
+
+// updates running CRC32 and CRC32 table of complete chunks with data received at domain offset
+static void fw_update_crc(Firmware *firmware, const uint8_t *data, uint32_t size) {
+  firmware->crc = fw_crc32(firmware->crc, data, size);
+  uint32_t offset = firmware->domain.Offset;
+  while (size) {
+    uint32_t n = std::min(size, CANOPEN_OTA_CHUNK_SIZE - offset % CANOPEN_OTA_CHUNK_SIZE);
+    firmware->chunk_crc = fw_crc32(firmware->chunk_crc, data, n);
+    offset += n;
+    data += n;
+    size -= n;
+    if (offset % CANOPEN_OTA_CHUNK_SIZE)
+      continue;
+    uint32_t chunk = offset / CANOPEN_OTA_CHUNK_SIZE - 1;
+    if (chunk < FW_CHUNK_CRC_N) {
+      FirmwareChunkCrc[chunk] = firmware->chunk_crc;
+      firmware->chunks = chunk + 1;
+      FirmwareChunkCrcObj.Size = firmware->chunks * sizeof(uint32_t);
+    }
+    firmware->chunk_crc = 0;
+  }
+}
+
 uint32_t FwImageSize(CO_OBJ *obj, CO_NODE *node, uint32_t width) {
   ESP_LOGI(TAG, "FwImageSize: %ld", width);
   Firmware *firmware = (Firmware *) (obj->Data);
@@ -38,7 +139,9 @@ uint32_t FwImageSize(CO_OBJ *obj, CO_NODE *node, uint32_t width) {
   /* allow firmware image smaller or equal to the domain memory area */
   if ((width < size) && (width > 0)) {
     size = width;
-    firmware->ota_size = size;
+    // may be called before or after FwImageReset(), which clears resume flag
+    firmware->transfer_size = size;
+    firmware->ota_size = (firmware->resume ? firmware->resume_offset : firmware->transfer_base) + size;
   }
   return size;
 }
@@ -56,17 +159,23 @@ CO_ERR FwImageWrite(CO_OBJ *obj, CO_NODE *node, void *buffer, uint32_t size) {
   Firmware *firmware = (Firmware *) (obj->Data);
   auto domain = &firmware->domain;
   CO_ERR result = CO_ERR_TYPE_WR;
-  uint32_t address = (uint32_t) domain->Start + domain->Offset;
 
   if (!((CanopenNode *) node)->canopen->ota) {
     ESP_LOGW(TAG, "FwImageWrite, ota not enabled");
     return CO_ERR_NONE;
   }
-  auto ret = ((CanopenNode *) node)->canopen->ota->write((uint8_t *) buffer, size);
+  firmware->resume = false;
+  return fw_image_append(firmware, ((CanopenNode *) node)->canopen, (uint8_t *) buffer, size);
+}
+
+CO_ERR fw_image_append(Firmware *firmware, CanopenComponent *canopen, uint8_t *buffer, uint32_t size) {
+  auto domain = &firmware->domain;
+  auto ret = canopen->ota->write(buffer, size);
   if (ret) {
     ESP_LOGE(TAG, "FwImageWrite, ret: %x", ret);
     return CO_ERR_OBJ_WRITE;
   }
+  fw_update_crc(firmware, buffer, size);
   uint32_t prev = domain->Offset;
   domain->Offset += size;
   if ((prev ^ domain->Offset) & ~1023) {
@@ -86,7 +195,7 @@ CO_ERR FwImageWrite(CO_OBJ *obj, CO_NODE *node, void *buffer, uint32_t size) {
     }
     ESP_LOGI(TAG, "FwImageWrite: upload complete, md5: %s", buf);
 
-    auto ret = ((CanopenNode *) node)->canopen->ota->end(buf);
+    auto ret = canopen->ota->end(buf);
     if (ret) {
       ESP_LOGE(TAG, "FwImageWrite, can't end update, ret: %x", ret);
       return CO_ERR_OBJ_WRITE;
@@ -99,7 +208,20 @@ CO_ERR FwImageReset(CO_OBJ *obj, CO_NODE *node, uint32_t para) {
   Firmware *firmware = (Firmware *) (obj->Data);
   auto domain = &firmware->domain;
   ESP_LOGI(TAG, "FwImageReset, size: %lu", firmware->size);
-  domain->Offset = 0;
+  if (firmware->resume) {
+    // OTA backend and decompressor keep their state, data is appended at resume offset;
+    // resume applies to this transfer only
+    domain->Offset = firmware->transfer_base = firmware->resume_offset;
+    firmware->resume = false;
+    if (firmware->transfer_size)
+      firmware->ota_size = firmware->transfer_base + firmware->transfer_size;
+    return CO_ERR_NONE;
+  }
+  domain->Offset = firmware->transfer_base = 0;
+  if (firmware->transfer_size)
+    firmware->ota_size = firmware->transfer_size;
+  fw_reset_crc(firmware);
+  firmware->multicast = false;
   if (!firmware->size) {
     return CO_ERR_OBJ_WRITE;
   }
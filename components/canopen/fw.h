@@ -23,9 +23,50 @@ struct Firmware {
   uint32_t size;
   uint32_t ota_size;
   uint8_t md5[32];
+  uint32_t crc;               // CRC32 of received data, exposed with domain offset for resuming
+  uint32_t resume_offset;     // offset of resumed transfer, valid if resume is set
+  uint32_t multicast_size;    // number of bytes streamed on OTA_MULTICAST_COB_ID
+  uint32_t multicast_missed;  // frames received after first missing one
+  uint32_t chunks;            // number of complete CANOPEN_OTA_CHUNK_SIZE chunks of received data
+  uint32_t chunk_crc;         // CRC32 of current (incomplete) chunk
+  uint32_t transfer_base;     // image offset of current SDO transfer (resume_offset or 0), set on reset
+  uint32_t transfer_size;     // size indicated for current SDO transfer
+  // OD mapped fields above must stay 4-byte aligned
+  bool resume;
+  bool multicast;
 };
 #pragma pack(pop)
 
+#ifndef CANOPEN_OTA_MULTICAST_COB_ID
+#define CANOPEN_OTA_MULTICAST_COB_ID 0x680u /* COB-ID of multicast image stream (`multicast_cob_id` option) */
+#endif
+#ifndef CANOPEN_OTA_CHUNK_SIZE
+#define CANOPEN_OTA_CHUNK_SIZE 4096u /* Size of received data chunk with own CRC32 in 0x3001 */
+#endif
+
+const uint32_t FW_IMAGE_MAX_SIZE = 1024 * 1024;
+const uint32_t FW_CHUNK_CRC_N = FW_IMAGE_MAX_SIZE / CANOPEN_OTA_CHUNK_SIZE;
+
+extern Firmware FirmwareObj;
+extern uint32_t FirmwareChunkCrc[FW_CHUNK_CRC_N];
+extern CO_OBJ_DOM FirmwareChunkCrcObj;
+
+const uint32_t FW_CTRL_ERASE = 0xdeadbeef;
+// next 0x3000:04 download continues interrupted transfer from 0x3000:06 offset
+const uint32_t FW_CTRL_RESUME = 0x72657375;
+// start receiving image streamed on CANOPEN_OTA_MULTICAST_COB_ID
+const uint32_t FW_CTRL_MULTICAST = 0x6d636173;
+
+// multicast frame: 24-bit chunk sequence number + up to 5 bytes of image data
+const uint32_t OTA_MULTICAST_COB_ID = CANOPEN_OTA_MULTICAST_COB_ID;
+const uint8_t FW_MULTICAST_SEQ_SIZE = 3;
+const uint8_t FW_MULTICAST_CHUNK_SIZE = 5;
+
+uint32_t fw_crc32(uint32_t crc, const uint8_t *data, uint32_t size);
+void fw_reset_crc(Firmware *firmware);
+CO_ERR fw_image_append(Firmware *firmware, CanopenComponent *canopen, uint8_t *buffer, uint32_t size);
+void fw_multicast_frame(CanopenComponent *canopen, const CO_IF_FRM *frm);
+
 uint32_t FwCtrlSize(CO_OBJ *obj, CO_NODE *node, uint32_t width);
 CO_ERR FwCtrlWrite(CO_OBJ *obj, CO_NODE *node, void *buffer, uint32_t size);
 
@@ -7,41 +7,87 @@ namespace canopen {
 static bool _pred(const CoObj &a, const uint32_t key) { return CO_GET_DEV(a.Key) < CO_GET_DEV(key); };
 
 CoObj *ObjectDictionary::find(uint32_t key) {
+  uint32_t dev = CO_GET_DEV(key);
+  if (is_frozen()) {
+    uint32_t n = index_keys.size() - 1;
+    uint32_t k = 1;
+    while (k <= n) {
+      k = 2 * k + (index_keys[k] < dev);
+    }
+    k >>= __builtin_ffs(~k);
+    if (k && index_keys[k] == dev) {
+      return &od[index_pos[k]];
+    }
+    return 0;
+  }
   auto ret = std::lower_bound(od.begin(), od.end(), key, _pred);
-  if (ret != od.end() && CO_GET_DEV(ret->Key) == CO_GET_DEV(key)) {
+  if (ret != od.end() && CO_GET_DEV(ret->Key) == dev) {
     return &*ret;
   }
   return 0;
 }
 
+CoObj *ObjectDictionary::insert(uint32_t key, const CO_OBJ_TYPE *type, CO_DATA data) {
+  if (od.size() == od.capacity()) {
+    ESP_LOGE("OD", "OD is full");
+    return 0;
+  }
+  // entries are mostly added in key order, so appending is the common case
+  if (od.empty() || CO_GET_DEV(od.back().Key) < CO_GET_DEV(key)) {
+    od.push_back({key, type, data});
+    return &od.back();
+  }
+  auto ret = std::lower_bound(od.begin(), od.end(), key, _pred);
+  return &*od.insert(ret, {key, type, data});
+}
+
 void ObjectDictionary::add_update(uint32_t key, const CO_OBJ_TYPE *type, CO_DATA data) {
   uint8_t sub = CO_GET_SUB(key);
 
-  auto ret = std::lower_bound(od.begin(), od.end(), key, _pred);
-  if (ret < od.end() && CO_GET_DEV(ret->Key) == CO_GET_DEV(key)) {
-    ret->Type = type;
-    ret->Data = data;
+  auto obj = find(key);
+  if (obj) {
+    obj->Type = type;
+    obj->Data = data;
     return;
-  } else {
-    if (od.size() == od.capacity()) {
-      ESP_LOGE("OD", "OD is full");
-      return;
-    }
-    od.insert(ret, {key, type, data});
-    if (sub) {
-      auto idx = CO_GET_IDX(key);
-      auto obj = find(CO_DEV(idx, 0));
-      if (obj) {
-        if (sub > obj->Data) {
-          obj->Data = sub;
-        }
-      } else {
-        add_update(CO_KEY(idx, 0, CO_OBJ_D___R_), CO_TUNSIGNED8, (CO_DATA) sub);
-      }
+  }
+  // index is no longer valid after insertion
+  index_keys.clear();
+  index_pos.clear();
+
+  if (!insert(key, type, data) || !sub)
+    return;
+
+  auto idx = CO_GET_IDX(key);
+  obj = find(CO_DEV(idx, 0));
+  if (obj) {
+    if (sub > obj->Data) {
+      obj->Data = sub;
     }
+  } else {
+    insert(CO_KEY(idx, 0, CO_OBJ_D___R_), CO_TUNSIGNED8, (CO_DATA) sub);
   }
 }
-void ObjectDictionary::append(uint32_t key, const CO_OBJ_TYPE *type, CO_DATA data) { od.push_back({key, type, data}); }
+void ObjectDictionary::append(uint32_t key, const CO_OBJ_TYPE *type, CO_DATA data) {
+  index_keys.clear();
+  index_pos.clear();
+  od.push_back({key, type, data});
+}
+
+uint32_t ObjectDictionary::build_index(uint32_t pos, uint32_t k) {
+  if (k < index_keys.size()) {
+    pos = build_index(pos, 2 * k);
+    index_keys[k] = CO_GET_DEV(od[pos].Key);
+    index_pos[k] = pos++;
+    pos = build_index(pos, 2 * k + 1);
+  }
+  return pos;
+}
+
+void ObjectDictionary::freeze() {
+  index_keys.assign(od.size() + 1, 0);
+  index_pos.assign(od.size() + 1, 0);
+  build_index(0, 1);
+}
 
 ObjectDictionary::ObjectDictionary(int capacity) {
   od.reserve(capacity);
@@ -12,12 +12,21 @@ namespace canopen {
 typedef struct CO_OBJ_T CoObj;
 
 class ObjectDictionary {
+  // lookup index in Eytzinger (BFS) layout, built by freeze()
+  std::vector<uint32_t> index_keys;
+  std::vector<uint16_t> index_pos;
+
+  CoObj *insert(uint32_t key, const CO_OBJ_TYPE *type, CO_DATA data);
+  uint32_t build_index(uint32_t pos, uint32_t k);
+
  public:
   std::vector<CoObj> od;
 
   CoObj *find(uint32_t key);
   void add_update(uint32_t key, const CO_OBJ_TYPE *type, CO_DATA data);
   void append(uint32_t key, const CO_OBJ_TYPE *type, CO_DATA data);
+  void freeze();
+  bool is_frozen() { return !index_keys.empty(); }
   ObjectDictionary(int capacity);
 };
 
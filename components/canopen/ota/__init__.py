@@ -10,7 +10,7 @@ from esphome.const import (
 )
 from esphome.core import coroutine_with_priority
 from esphome import automation
-from .. import CanopenComponent
+from .. import CanopenComponent, node_cob_ids
 
 _LOGGER = logging.getLogger(__name__)
 
@@ -23,11 +23,24 @@ ns = cg.esphome_ns.namespace("canopen")
 
 CanopenOTAComponent = ns.class_("CanopenOTAComponent", OTAComponent)
 
+# CiA 301 restricted COB-IDs (besides NMT), not to be used for application data
+RESTRICTED_COB_IDS = (
+    (0x001, 0x07F),
+    (0x101, 0x180),
+    (0x581, 0x5FF),
+    (0x601, 0x67F),
+    (0x6E0, 0x6FF),
+    (0x701, 0x7FF),
+)
+
 CONFIG_SCHEMA = (
     cv.Schema(
         {
             cv.GenerateID(): cv.declare_id(CanopenOTAComponent),
             cv.GenerateID("canopen_id"): cv.use_id(CanopenComponent),
+            cv.Optional("multicast_cob_id", default=0x680): cv.int_range(
+                min=0x001, max=0x7FF
+            ),
         }
     )
     .extend(BASE_OTA_SCHEMA)
@@ -35,9 +48,31 @@ CONFIG_SCHEMA = (
 )
 
 
+def final_validate_multicast_cob_id(config):
+    cob_id = config["multicast_cob_id"]
+    full_config = fv.full_config.get()
+    node_path = full_config.get_path_for_id(config["canopen_id"])[:-1]
+    node_config = full_config.get_config_for_path(node_path)
+    used_by = node_cob_ids(node_config).get(cob_id)
+    if used_by:
+        raise cv.Invalid(
+            f"multicast_cob_id 0x{cob_id:03x} is already used as {used_by} COB-ID "
+            f"of canopen node {node_config['node_id']}",
+            path=["multicast_cob_id"],
+        )
+    if any(first <= cob_id <= last for first, last in RESTRICTED_COB_IDS):
+        _LOGGER.warning(
+            "multicast_cob_id 0x%03x is in CiA 301 restricted range", cob_id
+        )
+
+
+FINAL_VALIDATE_SCHEMA = final_validate_multicast_cob_id
+
+
 @coroutine_with_priority(52.0)
 async def to_code(config):
     cg.add_define("USE_CANOPEN_OTA")
+    cg.add_define("CANOPEN_OTA_MULTICAST_COB_ID", config["multicast_cob_id"])
     var = cg.new_Pvariable(config[CONF_ID])
     await ota_to_code(var, config)
     await cg.register_component(var, config)
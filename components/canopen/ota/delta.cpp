@@ -0,0 +1,109 @@
+#include "delta.h"
+#include <algorithm>
+#include <cstring>
+
+namespace esphome {
+namespace canopen {
+
+static const uint8_t DELTA_MAGIC[DeltaDecoder::MAGIC_SIZE] = {'C', 'D', 'P', '1'};
+
+static uint32_t delta_u32(const uint8_t *ptr) {
+  uint32_t value;
+  memcpy(&value, ptr, sizeof(value));
+  return value;
+}
+
+bool DeltaDecoder::is_delta(const uint8_t *data) { return !memcmp(data, DELTA_MAGIC, MAGIC_SIZE); }
+
+void DeltaDecoder::reset() {
+  state = HEADER;
+  hdr_len = 0;
+  size = written = src = remaining = 0;
+}
+
+size_t DeltaDecoder::header_size() const {
+  if (state == HEADER)
+    return MAGIC_SIZE + 4;
+  if (!hdr_len)
+    return 1;
+  return hdr[0] == OP_INSERT ? 5 : 9;
+}
+
+bool DeltaDecoder::parse_header() {
+  if (state == HEADER) {
+    if (!is_delta(hdr))
+      return false;
+    size = delta_u32(hdr + MAGIC_SIZE);
+    state = OP;
+    return true;
+  }
+  uint8_t op = hdr[0];
+  if (op != OP_COPY && op != OP_ADD && op != OP_INSERT)
+    return false;
+  remaining = delta_u32(hdr + 1);
+  if (remaining > size - written)
+    return false;
+  if (op != OP_INSERT)
+    src = delta_u32(hdr + 5);
+  if (remaining)
+    state = op == OP_COPY ? COPY : op == OP_ADD ? ADD : INSERT;
+  return true;
+}
+
+bool DeltaDecoder::emit(uint8_t *data, size_t len) {
+  written += len;
+  return write(data, len);
+}
+
+int32_t DeltaDecoder::feed(const uint8_t *data, size_t len) {
+  size_t pos = 0;
+  while (pos < len && state != COPY) {
+    if (state == HEADER || state == OP) {
+      hdr[hdr_len++] = data[pos++];
+      if (state == OP && hdr_len == 1 && hdr[0] != OP_COPY && hdr[0] != OP_ADD && hdr[0] != OP_INSERT)
+        return -1;
+      if (hdr_len < header_size())
+        continue;
+      if (!parse_header())
+        return -1;
+      hdr_len = 0;
+      continue;
+    }
+    size_t n = std::min({len - pos, (size_t) remaining, sizeof(buf)});
+    if (state == ADD) {
+      if (!read_source || !read_source(src, buf, n))
+        return -1;
+      for (size_t i = 0; i < n; i++)
+        buf[i] += data[pos + i];
+      if (!emit(buf, n))
+        return -1;
+      src += n;
+    } else {
+      memcpy(buf, data + pos, n);
+      if (!emit(buf, n))
+        return -1;
+    }
+    pos += n;
+    remaining -= n;
+    if (!remaining)
+      state = OP;
+  }
+  return pos;
+}
+
+bool DeltaDecoder::step(size_t max_len) {
+  while (state == COPY && max_len) {
+    size_t n = std::min({(size_t) remaining, max_len, sizeof(buf)});
+    if (!read_source || !read_source(src, buf, n) || !emit(buf, n))
+      return false;
+    src += n;
+    remaining -= n;
+    max_len -= n;
+    if (!remaining)
+      state = OP;
+  }
+  return true;
+}
+
+}  // namespace canopen
+}  // namespace esphome
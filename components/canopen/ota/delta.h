@@ -0,0 +1,59 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+#ifndef CANOPEN_OTA_DELTA_BUF_SIZE
+#define CANOPEN_OTA_DELTA_BUF_SIZE 512u /* Buffer for COPY / ADD output */
+#endif
+
+namespace esphome {
+namespace canopen {
+
+/* Streaming decoder of delta images, new image is reconstructed from the running one.
+ * Delta image (little endian):
+ *   header:   "CDP1", u32 size of new image
+ *   commands: u8 op, u32 length, u32 source offset (COPY / ADD only), data (ADD / INSERT only)
+ *     COPY (1)   - copy `length` bytes of running image
+ *     ADD (2)    - add (mod 256) `length` data bytes to running image bytes
+ *     INSERT (3) - `length` data bytes of new image
+ * Output is produced in pieces of at most CANOPEN_OTA_DELTA_BUF_SIZE bytes, so RAM usage doesn't
+ * depend on image size; COPY is executed in steps, so it doesn't block the caller for long.
+ */
+class DeltaDecoder {
+ public:
+  static const uint8_t OP_COPY = 1;
+  static const uint8_t OP_ADD = 2;
+  static const uint8_t OP_INSERT = 3;
+  static const size_t MAGIC_SIZE = 4;
+
+  std::function<bool(uint32_t offset, uint8_t *buf, size_t len)> read_source;
+  std::function<bool(uint8_t *buf, size_t len)> write;
+
+  static bool is_delta(const uint8_t *data);
+  void reset();
+  // returns number of consumed bytes (less than len if COPY is pending), -1 on error
+  int32_t feed(const uint8_t *data, size_t len);
+  // executes up to max_len bytes of pending COPY, returns false on error
+  bool step(size_t max_len);
+  bool busy() const { return state == COPY; }
+  bool complete() const { return state == OP && !hdr_len && written == size; }
+
+ protected:
+  enum State : uint8_t { HEADER, OP, COPY, ADD, INSERT };
+  State state = HEADER;
+  uint8_t hdr[9];
+  uint8_t hdr_len = 0;
+  uint32_t size = 0;
+  uint32_t written = 0;
+  uint32_t src = 0;
+  uint32_t remaining = 0;
+  uint8_t buf[CANOPEN_OTA_DELTA_BUF_SIZE];
+
+  size_t header_size() const;
+  bool parse_header();
+  bool emit(uint8_t *data, size_t len);
+};
+
+}  // namespace canopen
+}  // namespace esphome
@@ -9,12 +9,21 @@
 #include "esphome/core/util.h"
 #include "esphome/core/base_automation.h"
 
+#ifdef USE_ESP32
+#include <esp_ota_ops.h>
+#endif
+
+#include <algorithm>
 #include <cerrno>
 #include <cstdio>
+#include <cstring>
+#include <strings.h>
 
 namespace esphome {
 namespace canopen {
 
+static_assert((CANOPEN_OTA_BUF_SIZE & (CANOPEN_OTA_BUF_SIZE - 1)) == 0, "CANOPEN_OTA_BUF_SIZE must be a power of two");
+
 void CanopenOTAComponent::setup() {
 #ifdef USE_OTA_STATE_CALLBACK
   ota::register_ota_platform(this);
@@ -56,14 +65,47 @@ void CanopenOTAComponent::setup() {
   automation_id->add_actions({delayaction_id, ota_end_id, delayaction2_id, reboot_action_id});
 #ifdef OTA_COMPRESSION
   this->stream = z_stream{};
+#endif
+  delta.write = [this](uint8_t *data, size_t len) { return write_flash(data, len); };
+#ifdef USE_ESP32
+  auto running = esp_ota_get_running_partition();
+  delta.read_source = [running](uint32_t offset, uint8_t *buf, size_t len) {
+    return running && esp_partition_read(running, offset, buf, len) == ESP_OK;
+  };
 #endif
 }
 
-void CanopenOTAComponent::loop() {}
+void CanopenOTAComponent::loop() {
+  if (state == STATE_FINISHING) {
+    process_end();
+  } else if (!error && (rx_head != rx_tail || delta.busy())) {
+    error = process(CANOPEN_OTA_LOOP_BYTES);
+  }
+  if (error && state == STATE_RECEIVING) {
+    ESP_LOGE(TAG, "ota error: %d, dropping buffered data", error);
+    rx_tail = rx_head;
+    state = STATE_FAILED;
+    state_error = error;
+  }
+  if (state != STATE_FINISHING && rx_head == rx_tail && !delta.busy()) {
+    hfq_requester.stop();
+  }
+}
 
 float CanopenOTAComponent::get_setup_priority() const { return setup_priority::LATE; }
 
 esphome::ota::OTAResponseTypes CanopenOTAComponent::begin(uint32_t size) {
+  rx_head = rx_tail = 0;
+  state = STATE_FAILED;
+  state_error = esphome::ota::OTAResponseTypes::OTA_RESPONSE_ERROR_UNKNOWN;
+  image_type = IMAGE_UNKNOWN;
+  image_head_len = 0;
+  delta.reset();
+  image_md5.init();
+  memset(image_md5_hex, 0, sizeof(image_md5_hex));
+  error = esphome::ota::OTAResponseTypes::OTA_RESPONSE_OK;
+  start_ms = millis();
+  stalls = 0;
 #ifdef OTA_COMPRESSION
   if(this->stream.state) {
     mz_deflateEnd(&this->stream);
@@ -74,6 +116,8 @@ esphome::ota::OTAResponseTypes CanopenOTAComponent::begin(uint32_t size) {
   this->stream.avail_in = 0;
   this->written = 0;
   this->received = 0;
+  this->out_tail = 0;
+  this->stream_end = false;
 
   int err = mz_inflateInit(&this->stream);
   if (err) {
@@ -81,98 +125,293 @@ esphome::ota::OTAResponseTypes CanopenOTAComponent::begin(uint32_t size) {
     return esphome::ota::OTAResponseTypes::OTA_RESPONSE_ERROR_UNKNOWN;
   }
 #endif
-  return !dry_run ? backend->begin(size) : esphome::ota::OTAResponseTypes::OTA_RESPONSE_OK;
+  auto ret = !dry_run ? backend->begin(size) : esphome::ota::OTAResponseTypes::OTA_RESPONSE_OK;
+  state = ret == esphome::ota::OTAResponseTypes::OTA_RESPONSE_OK ? STATE_RECEIVING : STATE_FAILED;
+  state_error = ret;
+  return ret;
+}
+
+bool CanopenOTAComponent::write_flash(uint8_t *data, size_t len) {
+  ESP_LOGV(TAG, "writing %d bytes to flash", len);
+  image_md5.add(data, len);
+  auto ret = !dry_run ? backend->write(data, len) : esphome::ota::OTAResponseTypes::OTA_RESPONSE_OK;
+  if (ret != esphome::ota::OTAResponseTypes::OTA_RESPONSE_OK) {
+    ESP_LOGW(TAG, "write flash error: %d", ret);
+    return false;
+  }
+  return true;
+}
+
+// passes (decompressed) image data to delta decoder or directly to flash,
+// returns number of consumed bytes (less than len if delta decoder is busy), -1 on error
+int32_t CanopenOTAComponent::output(uint8_t *data, size_t len) {
+  if (image_type == IMAGE_UNKNOWN) {
+    size_t n = std::min(len, sizeof(image_head) - image_head_len);
+    memcpy(image_head + image_head_len, data, n);
+    image_head_len += n;
+    if (image_head_len < sizeof(image_head)) {
+      return n;
+    }
+    image_type = DeltaDecoder::is_delta(image_head) ? IMAGE_DELTA : IMAGE_FULL;
+    if (image_type == IMAGE_FULL) {
+      return write_flash(image_head, sizeof(image_head)) ? n : -1;
+    }
+    if (!delta.read_source) {
+      ESP_LOGW(TAG, "delta images are not supported on this platform");
+      return -1;
+    }
+    ESP_LOGI(TAG, "delta image, patching running firmware");
+    return delta.feed(image_head, sizeof(image_head)) < 0 ? -1 : n;
+  }
+  if (image_type == IMAGE_DELTA) {
+    auto n = delta.feed(data, len);
+    if (n < 0) {
+      ESP_LOGW(TAG, "invalid delta image");
+    }
+    return n;
+  }
+  return write_flash(data, len) ? len : -1;
 }
 
 #ifdef OTA_COMPRESSION
-int CanopenOTAComponent::decompress() {
-  auto status = inflate(&this->stream, Z_SYNC_FLUSH);
-  if ((status == Z_STREAM_END) || (status == Z_OK && !this->stream.avail_out)) {
-    uint32_t n = BUF_SIZE - this->stream.avail_out;
+// passes inflated data to output(), returns -1 on error, 0 if output is busy, 1 if inflate can continue
+int CanopenOTAComponent::flush_output(bool partial) {
+  uint32_t head = BUF_SIZE - this->stream.avail_out;
+  // full buffers are written unless stream is finished
+  if (!partial && head < BUF_SIZE) {
+    return 1;
+  }
+  if (this->out_tail < head) {
+    auto n = output(this->s_outbuf + this->out_tail, head - this->out_tail);
+    if (n < 0) {
+      return -1;
+    }
+    this->out_tail += n;
     this->written += n;
-    if(n > 0) {
-      ESP_LOGI(TAG, "writing %ld bytes to flash, total: %ld", n, this->written);
-      auto ret = !dry_run ? backend->write(this->s_outbuf, n) : esphome::ota::OTAResponseTypes::OTA_RESPONSE_OK;
-      if (ret != esphome::ota::OTAResponseTypes::OTA_RESPONSE_OK) {
-        ESP_LOGW("ota", "write flash error: %d", ret);
-        return -10;
-      }
+    if (this->out_tail < head) {
+      return 0;
     }
-    this->stream.next_out = this->s_outbuf;
-    this->stream.avail_out = BUF_SIZE;
   }
-  return status;
+  this->stream.next_out = this->s_outbuf;
+  this->stream.avail_out = BUF_SIZE;
+  this->out_tail = 0;
+  return 1;
 }
 #endif
 
-esphome::ota::OTAResponseTypes CanopenOTAComponent::write(uint8_t *data, size_t len) {
+// continues work of previous consume() calls, returns -1 on error, 0 if still busy, 1 if new data can be consumed
+int CanopenOTAComponent::pump(uint32_t max_len) {
+  if (delta.busy()) {
+    if (!delta.step(max_len)) {
+      ESP_LOGW(TAG, "delta image: can't copy running firmware data");
+      return -1;
+    }
+    if (delta.busy()) {
+      return 0;
+    }
+  }
 #ifdef OTA_COMPRESSION
-  ESP_LOGV(
-    TAG,
-    "offset: %ld, len: %d, data: %02x %02x %02x %02x %02x %02x %02x",
-    this->received, len,
-    data[0], data[1], data[2], data[3],
-    data[3], data[4], data[6]
-  );
+  int ret = flush_output(this->stream_end);
+  // flushed data may start new COPY
+  return ret > 0 && delta.busy() ? 0 : ret;
+#else
+  return 1;
+#endif
+}
+
+// returns number of consumed bytes, -1 on error
+int32_t CanopenOTAComponent::consume(uint8_t *data, size_t len) {
+#ifdef OTA_COMPRESSION
+  ESP_LOGV(TAG, "offset: %ld, len: %d", this->received, len);
   this->stream.next_in = data;
   this->stream.avail_in = len;
-  this->received += len;
 
-  while (stream.avail_in) {
-    int status = this->decompress();
-    if (status == Z_STREAM_END) {
+  for (;;) {
+    int ret = flush_output(this->stream_end);
+    if (ret <= 0) {
+      break;
+    }
+    if (this->stream_end) {
+      // trailing data after end of compressed stream is ignored
+      this->stream.avail_in = 0;
       break;
     }
-    if (status != Z_OK) {
+    if (!this->stream.avail_in) {
+      break;
+    }
+    auto status = inflate(&this->stream, Z_SYNC_FLUSH);
+    if (status == Z_STREAM_END) {
+      this->stream_end = true;
+    } else if (status != Z_OK) {
       ESP_LOGW(TAG, "decompression failed with %d", status);
-      return esphome::ota::OTAResponseTypes::OTA_RESPONSE_ERROR_UNKNOWN;
+      return -1;
     }
   }
+  uint32_t n = len - this->stream.avail_in;
+  this->received += n;
+  return n;
 #else
-  ESP_LOGI(TAG, "ota write %d bytes", len);
-  if(!dry_run) {
-    return backend->write(data, len);
-  }
+  return output(data, len);
 #endif
+}
+
+esphome::ota::OTAResponseTypes CanopenOTAComponent::process(uint32_t max_len) {
+  int ret = pump(CANOPEN_OTA_LOOP_BYTES);
+  if (ret < 0) {
+    return esphome::ota::OTAResponseTypes::OTA_RESPONSE_ERROR_UNKNOWN;
+  }
+  while (ret > 0 && rx_head != rx_tail && max_len) {
+    uint32_t pos = rx_tail & (CANOPEN_OTA_BUF_SIZE - 1);
+    uint32_t n = std::min({rx_head - rx_tail, CANOPEN_OTA_BUF_SIZE - pos, max_len});
+    auto consumed = consume(rx_buf + pos, n);
+    if (consumed < 0) {
+      return esphome::ota::OTAResponseTypes::OTA_RESPONSE_ERROR_UNKNOWN;
+    }
+    rx_tail += consumed;
+    max_len -= consumed;
+    if ((uint32_t) consumed < n) {
+      break;  // delta decoder busy, continued by pump()
+    }
+  }
+  return esphome::ota::OTAResponseTypes::OTA_RESPONSE_OK;
+}
+
+esphome::ota::OTAResponseTypes CanopenOTAComponent::write(uint8_t *data, size_t len) {
+  if (error || state != STATE_RECEIVING) {
+    return error ? error : esphome::ota::OTAResponseTypes::OTA_RESPONSE_ERROR_UNKNOWN;
+  }
+  if (len > CANOPEN_OTA_BUF_SIZE - (rx_head - rx_tail)) {
+    // backpressure: buffer is full, SDO handler waits for flash, but not longer than CANOPEN_OTA_HANDLER_MS
+    // (long delta COPY would exceed SDO timeout of the master)
+    stalls++;
+    uint32_t wait_start_ms = millis();
+    while (len > CANOPEN_OTA_BUF_SIZE - (rx_head - rx_tail)) {
+      auto ret = process(CANOPEN_OTA_LOOP_BYTES);
+      if (ret != esphome::ota::OTAResponseTypes::OTA_RESPONSE_OK) {
+        return error = ret;
+      }
+      if (millis() - wait_start_ms >= CANOPEN_OTA_HANDLER_MS) {
+        // update is not failed, data isn't counted as received, so master can resume from 0x3000:06 later
+        ESP_LOGW(TAG, "flash busy, %d bytes rejected", len);
+        return esphome::ota::OTAResponseTypes::OTA_RESPONSE_ERROR_WRITING_FLASH;
+      }
+      App.feed_wdt();
+    }
+  }
+  uint32_t pos = rx_head & (CANOPEN_OTA_BUF_SIZE - 1);
+  uint32_t n = std::min((uint32_t) len, CANOPEN_OTA_BUF_SIZE - pos);
+  memcpy(rx_buf + pos, data, n);
+  memcpy(rx_buf, data + n, len - n);
+  rx_head += len;
+  hfq_requester.start();
   return esphome::ota::OTAResponseTypes::OTA_RESPONSE_OK;
 }
 
 esphome::ota::OTAResponseTypes CanopenOTAComponent::end(const char *expected_md5) {
-  esphome::ota::OTAResponseTypes ret;
+  if (error) {
+    return error;
+  }
+  if (state != STATE_RECEIVING) {
+    return esphome::ota::OTAResponseTypes::OTA_RESPONSE_ERROR_UNKNOWN;
+  }
+  strncpy(this->expected_md5, expected_md5, sizeof(this->expected_md5) - 1);
+  this->expected_md5[sizeof(this->expected_md5) - 1] = 0;
+  // called before last segment is acknowledged, so SDO master gets the result of decompression, flash writes
+  // and MD5 check instead of success for merely buffered data - as long as it fits in CANOPEN_OTA_HANDLER_MS
+  state = STATE_FINISHING;
+  end_ms = millis();
+  while (state == STATE_FINISHING && millis() - end_ms < CANOPEN_OTA_HANDLER_MS) {
+    process_end();
+    App.feed_wdt();
+  }
+  if (state == STATE_FAILED) {
+    return error;
+  }
+  if (state == STATE_FINISHING) {
+    ESP_LOGI(TAG, "image processing continues in background, result will be reported in 0x3000:0A");
+    hfq_requester.start();
+  }
+  return esphome::ota::OTAResponseTypes::OTA_RESPONSE_OK;
+}
+
+// single step of work remaining after end(): buffered data, decompressor / delta decoder tail and MD5 check,
+// switches state to STATE_DONE (and schedules reboot) or STATE_FAILED when finished
+void CanopenOTAComponent::process_end() {
+  if (!error && (rx_head != rx_tail || delta.busy())) {
+    error = process(CANOPEN_OTA_LOOP_BYTES);
+    if (!error) {
+      return;
+    }
+  } else if (!error) {
+    int ret = finish_step();
+    if (!ret) {
+      return;
+    }
+    if (ret < 0) {
+      error = esphome::ota::OTAResponseTypes::OTA_RESPONSE_ERROR_UNKNOWN;
+    }
+  }
+  if (error) {
+    rx_tail = rx_head;
+    state = STATE_FAILED;
+    state_error = error;
+    ESP_LOGE(TAG, "ota error: %d", error);
+    return;
+  }
+  ESP_LOGI(TAG, "image processed in %ldms (%ldms after last segment), buffer stalls: %ld", millis() - start_ms,
+           millis() - end_ms, stalls);
+  state = STATE_DONE;
+  finish();
+}
+
+// processes data remaining in decompressor / delta decoder, returns -1 on error, 0 if not finished yet, 1 when done
+int CanopenOTAComponent::finish_step() {
+  int ret = pump(CANOPEN_OTA_LOOP_BYTES);
+  if (ret <= 0) {
+    return ret;
+  }
 #ifdef OTA_COMPRESSION
-  for (;;) {
-    auto status = this->decompress();
+  if (!this->stream_end) {
+    this->stream.avail_in = 0;
+    auto status = inflate(&this->stream, Z_SYNC_FLUSH);
     if (status == Z_STREAM_END) {
-      ret = esphome::ota::OTAResponseTypes::OTA_RESPONSE_OK;
-      if (!dry_run) {
-        backend->set_update_md5(expected_md5);
-      }
-      ota_finished_trigger->trigger();
-      // if (!ret) {
-      //   ESP_LOGI(TAG, "decompression finished successfully");
-      //   if(!dry_run && !disable_ota_reboot) {
-      //     ota_finished_trigger->trigger();
-      //   }
-      // }
-      break;
+      this->stream_end = true;
     } else if (status != Z_OK) {
       ESP_LOGW(TAG, "decompression failed with %d", status);
-      ret = esphome::ota::OTAResponseTypes::OTA_RESPONSE_ERROR_UNKNOWN;
-      break;
+      return -1;
     }
+    return 0;
   }
+  ESP_LOGI(TAG, "decompressed %ld bytes", this->written);
+#endif
+  if (image_type == IMAGE_UNKNOWN && image_head_len && !write_flash(image_head, image_head_len)) {
+    return -1;
+  }
+  if (image_type == IMAGE_DELTA && !delta.complete()) {
+    ESP_LOGW(TAG, "delta image is incomplete");
+    return -1;
+  }
+  // verified here, so corrupted image is reported before backend is finalized
+  image_md5.calculate();
+  image_md5.get_hex(image_md5_hex);
+  if (strcasecmp(image_md5_hex, expected_md5)) {
+    ESP_LOGE(TAG, "image md5 mismatch: %s, expected: %s", image_md5_hex, expected_md5);
+    return -1;
+  }
+  return 1;
+}
+
+void CanopenOTAComponent::finish() {
+#ifdef OTA_COMPRESSION
   mz_deflateEnd(&this->stream);
-#else
-  ret = esphome::ota::OTAResponseTypes::OTA_RESPONSE_OK;
-  if(!dry_run) {
+#endif
+  if (!dry_run) {
     backend->set_update_md5(expected_md5);
   }
   // let's finish update asynchronously
   // as on stm32 platform calling backend->end() instantly reboots
   // and canopen block transfer is not finished
   ota_finished_trigger->trigger();
-#endif
-  return ret;
 }
 
 }  // namespace canopen
@@ -15,6 +15,18 @@
 #include "esphome/core/automation.h"
 
 #include "esphome/components/ota/ota_backend.h"
+#include "esphome/components/md5/md5.h"
+#include "delta.h"
+
+#ifndef CANOPEN_OTA_BUF_SIZE
+#define CANOPEN_OTA_BUF_SIZE 4096u /* Received image data buffer, must be a power of two */
+#endif
+#ifndef CANOPEN_OTA_LOOP_BYTES
+#define CANOPEN_OTA_LOOP_BYTES 1024u /* Max number of buffered bytes processed in single loop() */
+#endif
+#ifndef CANOPEN_OTA_HANDLER_MS
+#define CANOPEN_OTA_HANDLER_MS 100u /* Max time spent processing image data by single SDO handler call */
+#endif
 
 namespace esphome {
 namespace canopen {
@@ -31,12 +43,49 @@ class CanopenOTAComponent : public ota::OTAComponent {
   uint8_t s_outbuf[BUF_SIZE];
   uint32_t written;
   uint32_t received;
-  int decompress();
+  uint32_t out_tail;  // inflated data already passed to output()
+  bool stream_end;
+  int flush_output(bool partial);
 #endif
 
   bool dry_run = false;
 
+  // data received by SDO handler, inflated / written to flash in loop()
+  uint8_t rx_buf[CANOPEN_OTA_BUF_SIZE];
+  uint32_t rx_head = 0;  // free running counters
+  uint32_t rx_tail = 0;
+  char expected_md5[33];
+  esphome::ota::OTAResponseTypes error = esphome::ota::OTAResponseTypes::OTA_RESPONSE_OK;
+  uint32_t start_ms;
+  uint32_t end_ms;
+  uint32_t stalls;
+  HighFrequencyLoopRequester hfq_requester;
+
+  // delta images are recognized by DeltaDecoder magic at the beginning of (decompressed) image
+  enum ImageType : uint8_t { IMAGE_UNKNOWN, IMAGE_FULL, IMAGE_DELTA };
+  ImageType image_type;
+  uint8_t image_head[DeltaDecoder::MAGIC_SIZE];
+  uint8_t image_head_len;
+  DeltaDecoder delta;
+  // computed over data written to flash (after decompression / patching)
+  md5::MD5Digest image_md5;
+  char image_md5_hex[33];
+
+  bool write_flash(uint8_t *data, size_t len);
+  int32_t output(uint8_t *data, size_t len);
+  int32_t consume(uint8_t *data, size_t len);
+  int pump(uint32_t max_len);
+  int finish_step();
+  void process_end();
+  esphome::ota::OTAResponseTypes process(uint32_t max_len);
+  void finish();
+
  public:
+  // update state exposed in 0x3000:0A, error of failed update in 0x3000:0B
+  enum State : uint8_t { STATE_IDLE, STATE_RECEIVING, STATE_FINISHING, STATE_DONE, STATE_FAILED };
+  uint8_t state = STATE_IDLE;
+  uint8_t state_error = 0;
+
   bool disable_ota_reboot = false;
   std::unique_ptr<esphome::ota::OTABackend> backend;
   void setup() override;
@@ -44,8 +93,16 @@ class CanopenOTAComponent : public ota::OTAComponent {
   float get_setup_priority() const override;
   void loop() override;
 
+  // hex encoded MD5 of written image, empty until whole image is processed
+  const char *get_image_md5() const { return image_md5_hex; }
+  // update was started and is neither completed nor failed
+  bool in_progress() const { return state == STATE_RECEIVING && !error; }
   esphome::ota::OTAResponseTypes begin(uint32_t size);
+  // data is buffered, if buffer is full it is processed synchronously (slowing down the transfer) for at most
+  // CANOPEN_OTA_HANDLER_MS, then data is rejected without failing the update (upload can be resumed)
   esphome::ota::OTAResponseTypes write(uint8_t *data, size_t len);
+  // processes remaining data and verifies image MD5 for at most CANOPEN_OTA_HANDLER_MS, what doesn't fit
+  // (e.g. delta COPY of unchanged tail) is finished in loop() and its result is reported only in `state`
   esphome::ota::OTAResponseTypes end(const char *expected_md5);
 };
 }  // namespace canopen
@@ -0,0 +1,59 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+namespace esphome {
+namespace canopen {
+
+/* Fixed-capacity single producer / single consumer queue.
+ * push() and pop() may be called from different tasks without locking,
+ * as long as there is only one producer and one consumer.
+ */
+template<typename T, uint32_t N> class RingBuffer {
+  static_assert(N > 0 && (N & (N - 1)) == 0, "RingBuffer capacity must be a power of two");
+
+  T items[N];
+  std::atomic<uint32_t> head{0};
+  std::atomic<uint32_t> tail{0};
+
+ public:
+  uint32_t overflows = 0;
+  uint32_t high_water = 0;
+
+  bool push(const T &item) {
+    uint32_t h = head.load(std::memory_order_relaxed);
+    uint32_t size = h - tail.load(std::memory_order_acquire);
+    if (size >= N) {
+      overflows++;
+      return false;
+    }
+    items[h & (N - 1)] = item;
+    head.store(h + 1, std::memory_order_release);
+    if (size + 1 > high_water)
+      high_water = size + 1;
+    return true;
+  }
+
+  T *front() {
+    uint32_t t = tail.load(std::memory_order_relaxed);
+    if (t == head.load(std::memory_order_acquire))
+      return nullptr;
+    return &items[t & (N - 1)];
+  }
+
+  bool pop(T &item) {
+    T *ptr = front();
+    if (!ptr)
+      return false;
+    item = *ptr;
+    tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    return true;
+  }
+
+  uint32_t size() { return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire); }
+  bool empty() { return size() == 0; }
+  constexpr uint32_t capacity() const { return N; }
+};
+
+}  // namespace canopen
+}  // namespace esphome
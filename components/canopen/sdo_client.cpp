@@ -0,0 +1,127 @@
+#include "esphome.h"
+#include "canopen.h"
+#include "sdo_client.h"
+
+namespace esphome {
+namespace canopen {
+
+void SdoClient::upload(uint8_t node_id, uint32_t key, uint32_t max_size,
+                       std::function<void(SdoRequest &, uint32_t)> cb) {
+  submit({node_id, key, true, CO_COBID_SDO_REQUEST() + node_id, CO_COBID_SDO_RESPONSE() + node_id,
+          std::vector<uint8_t>(max_size), default_timeout_ms, default_retries, cb});
+}
+
+void SdoClient::download(uint8_t node_id, uint32_t key, const uint8_t *data, uint32_t size,
+                         std::function<void(SdoRequest &, uint32_t)> cb) {
+  submit({node_id, key, false, CO_COBID_SDO_REQUEST() + node_id, CO_COBID_SDO_RESPONSE() + node_id,
+          std::vector<uint8_t>(data, data + size), default_timeout_ms, default_retries, cb});
+}
+
+void SdoClient::submit(SdoRequest req) {
+  queue.push_back(std::move(req));
+}
+
+bool SdoClient::is_idle() const {
+  for (auto b : busy) {
+    if (b)
+      return false;
+  }
+  return queue.empty();
+}
+
+bool SdoClient::start(uint8_t channel) {
+  auto csdo = COCSdoFind(node, channel);
+  if (!csdo)
+    return false;
+  auto &req = active[channel];
+  req.size = 0;
+  canopen->rx_filter.add(req.rx_id);
+  csdo->NodeId = req.node_id;
+  csdo->TxId = req.tx_id;
+  csdo->RxId = req.rx_id;
+  ESP_LOGV(TAG, "channel %d: %s node: %02x key: %06lx size: %d", channel, req.upload ? "upload" : "download",
+           req.node_id, req.key >> 8, req.data.size());
+  CO_ERR err;
+  if (req.upload) {
+    err = COCSdoRequestUpload(csdo, req.key, req.data.data(), req.data.size(), on_done, req.timeout_ms);
+  } else {
+    err = COCSdoRequestDownload(csdo, req.key, req.data.data(), req.data.size(), on_done, req.timeout_ms);
+  }
+  if (err != CO_ERR_NONE) {
+    ESP_LOGW(TAG, "channel %d: can't start request to node %02x, err: %d", channel, req.node_id, err);
+    return false;
+  }
+  busy[channel] = true;
+  return true;
+}
+
+void SdoClient::on_done(CO_CSDO *csdo, uint16_t index, uint8_t sub, uint32_t code) {
+  auto client = ((CanopenNode *) csdo->Node)->canopen->get_sdo_client();
+  uint8_t channel = csdo - COCSdoFind(csdo->Node, 0);
+  auto &req = client->active[channel];
+  ESP_LOGV(TAG, "channel %d: node: %02x %04x %02x done, code: %08lx", channel, req.node_id, index, sub, code);
+  client->busy[channel] = false;
+  if (code == SDO_ABORT_TIMEOUT && req.retries) {
+    req.retries--;
+    ESP_LOGD(TAG, "node: %02x %04x %02x timeout, retrying", req.node_id, index, sub);
+    client->queue.push_front(std::move(req));
+    return;
+  }
+  if (req.cb) {
+    // callback may submit new requests, so it works on moved out request
+    auto done = std::move(req);
+    done.cb(done, code);
+  }
+}
+
+void SdoClient::on_frame(const CO_IF_FRM &frm) {
+  for (uint8_t channel = 0; channel < CO_CSDO_N; channel++) {
+    auto &req = active[channel];
+    if (!busy[channel] || !req.upload || frm.Identifier != req.rx_id || frm.DLC < 8)
+      continue;
+    uint8_t scs = frm.Data[0] >> 5;
+    if (scs == 2) {
+      // initiate upload response: expedited (e) with size indicated (s) in n, segmented data follows otherwise
+      bool expedited = frm.Data[0] & 0x02, size_indicated = frm.Data[0] & 0x01;
+      req.size = !expedited ? 0 : size_indicated ? 4 - ((frm.Data[0] >> 2) & 3) : 4;
+    } else if (scs == 0) {
+      // upload segment response, n: number of bytes without data
+      req.size += 7 - ((frm.Data[0] >> 1) & 7);
+    }
+    if (req.size > req.data.size())
+      req.size = req.data.size();
+  }
+}
+
+bool SdoClient::is_server_busy(uint32_t tx_id) const {
+  for (uint8_t channel = 0; channel < CO_CSDO_N; channel++) {
+    if (busy[channel] && active[channel].tx_id == tx_id)
+      return true;
+  }
+  return false;
+}
+
+void SdoClient::loop() {
+  if (!node)
+    return;
+  for (uint8_t channel = 0; channel < CO_CSDO_N && !queue.empty(); channel++) {
+    if (busy[channel])
+      continue;
+    // server handles single transfer at a time, requests to busy servers wait in queue
+    auto it = queue.begin();
+    while (it != queue.end() && is_server_busy(it->tx_id))
+      it++;
+    if (it == queue.end())
+      break;
+    active[channel] = std::move(*it);
+    queue.erase(it);
+    if (!start(channel)) {
+      auto &req = active[channel];
+      if (req.cb)
+        req.cb(req, SDO_ABORT_GENERAL);
+    }
+  }
+}
+
+}  // namespace canopen
+}  // namespace esphome
@@ -0,0 +1,67 @@
+#pragma once
+#include <deque>
+#include <functional>
+#include <vector>
+#include "co_core.h"
+
+namespace esphome {
+namespace canopen {
+
+class CanopenComponent;
+
+const uint32_t SDO_ABORT_TIMEOUT = 0x05040000;
+const uint32_t SDO_ABORT_GENERAL = 0x08000000;
+
+struct SdoRequest {
+  uint8_t node_id;
+  uint32_t key;
+  bool upload;
+  uint32_t tx_id;
+  uint32_t rx_id;
+  // upload: zero filled buffer of max expected size, download: data to send
+  std::vector<uint8_t> data;
+  uint32_t timeout_ms;
+  uint8_t retries;
+  // called with abort code, 0 on success
+  std::function<void(SdoRequest &req, uint32_t code)> cb;
+  // upload: number of bytes received, data beyond it stays zero filled
+  uint32_t size;
+};
+
+/* Queue of SDO client requests, executed on all CO_CSDO_N client channels in parallel.
+ * Channels are retargeted to the request node before each transfer, expedited and
+ * segmented transfers of any size are handled by canopen-stack. Requests to the same
+ * node are executed one after another.
+ */
+class SdoClient {
+  CanopenComponent *canopen;
+  CO_NODE *node = nullptr;
+  std::deque<SdoRequest> queue;
+  SdoRequest active[CO_CSDO_N];
+  bool busy[CO_CSDO_N] = {};
+
+  bool start(uint8_t channel);
+  bool is_server_busy(uint32_t tx_id) const;
+  static void on_done(CO_CSDO *csdo, uint16_t index, uint8_t sub, uint32_t code);
+
+ public:
+  uint32_t default_timeout_ms = 1000;
+  uint8_t default_retries = 0;
+
+  explicit SdoClient(CanopenComponent *canopen) : canopen(canopen) {}
+  void set_node(CO_NODE *node) { this->node = node; }
+
+  void upload(uint8_t node_id, uint32_t key, uint32_t max_size, std::function<void(SdoRequest &, uint32_t)> cb);
+  void download(uint8_t node_id, uint32_t key, const uint8_t *data, uint32_t size,
+                std::function<void(SdoRequest &, uint32_t)> cb = nullptr);
+  void submit(SdoRequest req);
+  void loop();
+  // snoops server responses of active uploads for received size, frame is still processed by canopen-stack
+  void on_frame(const CO_IF_FRM &frm);
+
+  size_t pending() const { return queue.size(); }
+  bool is_idle() const;
+};
+
+}  // namespace canopen
+}  // namespace esphome
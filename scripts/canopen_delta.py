@@ -0,0 +1,192 @@
+#!/usr/bin/env python3
+"""Creates delta OTA image (CDP1) of new firmware against the running one.
+
+Delta image is uploaded to 0x3000:04 the same way as full image, 0x3000:03 must be
+set to MD5 of the new firmware (printed by this script). COPY of unchanged tail may
+be finished after the last segment is acknowledged, so the result of the update is
+read from 0x3000:0A. Format is described in OBJECT_DICTIONARY.md:
+
+  header:   "CDP1", u32 size of new image
+  commands: u8 op, u32 length, u32 source offset (COPY / ADD), data (ADD / INSERT)
+
+Images are zlib compressed unless --raw is given (nodes built with OTA compression
+expect compressed data). Patch is applied and verified before it is written.
+
+usage: canopen_delta.py old.bin new.bin -o patch.bin [--raw]
+"""
+import argparse
+import hashlib
+import struct
+import sys
+import zlib
+
+MAGIC = b"CDP1"
+OP_COPY = 1
+OP_ADD = 2
+OP_INSERT = 3
+
+# granularity of matching, data shorter than block is sent as INSERT
+BLOCK = 32
+# ADD is used for blocks with less than BLOCK / ADD_MAX_DIFF changed bytes
+ADD_MAX_DIFF = 4
+
+
+def match_length(old, j, new, i):
+    """Number of equal bytes of old[j:] and new[i:]."""
+    n = 0
+    step = 4096
+    while step:
+        while (
+            i + n + step <= len(new)
+            and j + n + step <= len(old)
+            and old[j + n : j + n + step] == new[i + n : i + n + step]
+        ):
+            n += step
+        step //= 8
+    return n
+
+
+def diff_count(old, j, new, i, n):
+    if j < 0 or j + n > len(old):
+        return n
+    return sum(a != b for a, b in zip(old[j : j + n], new[i : i + n]))
+
+
+class Writer:
+    """Serializes commands, merges adjacent INSERT / ADD commands."""
+
+    def __init__(self, new_size):
+        self.out = bytearray(MAGIC + struct.pack("<I", new_size))
+        self.ops = []  # [op, length, src, data]
+        self.stats = {OP_COPY: 0, OP_ADD: 0, OP_INSERT: 0}
+
+    def add(self, op, length, src=0, data=b""):
+        last = self.ops[-1] if self.ops else None
+        if last and last[0] == op == OP_INSERT:
+            last[1] += length
+            last[3] += data
+        elif last and last[0] == op == OP_ADD and last[2] + last[1] == src:
+            last[1] += length
+            last[3] += data
+        else:
+            self.ops.append([op, length, src, bytearray(data)])
+
+    def finish(self):
+        for op, length, src, data in self.ops:
+            self.stats[op] += length
+            if op == OP_INSERT:
+                self.out += struct.pack("<BI", op, length) + data
+            else:
+                self.out += struct.pack("<BII", op, length, src) + data
+        return bytes(self.out)
+
+
+def make_delta(old, new):
+    index = {}
+    for j in range(0, len(old) - BLOCK + 1, BLOCK):
+        index.setdefault(old[j : j + BLOCK], j)
+
+    writer = Writer(len(new))
+    shift = 0  # source offset - new offset of last COPY, data moved as a whole
+    literal = bytearray()
+    i = 0
+
+    def flush_literal():
+        if literal:
+            writer.add(OP_INSERT, len(literal), data=bytes(literal))
+            literal.clear()
+
+    while i < len(new):
+        block = new[i : i + BLOCK]
+        j = None
+        if len(block) == BLOCK:
+            if i + shift >= 0 and old[i + shift : i + shift + BLOCK] == block:
+                j = i + shift
+            else:
+                j = index.get(block)
+        if j is not None:
+            # extend match backwards into pending literal data
+            while literal and j > 0 and old[j - 1] == literal[-1]:
+                literal.pop()
+                i -= 1
+                j -= 1
+            flush_literal()
+            n = match_length(old, j, new, i)
+            writer.add(OP_COPY, n, j)
+            shift = j - i
+            i += n
+            continue
+        n = min(BLOCK, len(new) - i)
+        j = i + shift
+        if n == BLOCK and diff_count(old, j, new, i, n) < BLOCK // ADD_MAX_DIFF:
+            # mostly unchanged data, e.g. code with relocated addresses
+            flush_literal()
+            data = bytes((new[i + k] - old[j + k]) & 0xFF for k in range(n))
+            writer.add(OP_ADD, n, j, data)
+            i += n
+            continue
+        literal.append(new[i])
+        i += 1
+    flush_literal()
+    return writer.finish(), writer.stats
+
+
+def apply_delta(old, patch):
+    if patch[:4] != MAGIC:
+        raise ValueError("not a delta image")
+    (size,) = struct.unpack_from("<I", patch, 4)
+    out = bytearray()
+    pos = 8
+    while pos < len(patch):
+        op, length = struct.unpack_from("<BI", patch, pos)
+        pos += 5
+        if op == OP_INSERT:
+            out += patch[pos : pos + length]
+            pos += length
+            continue
+        (src,) = struct.unpack_from("<I", patch, pos)
+        pos += 4
+        if op == OP_COPY:
+            out += old[src : src + length]
+        elif op == OP_ADD:
+            source = old[src : src + length]
+            data = patch[pos : pos + length]
+            out += bytes((a + b) & 0xFF for a, b in zip(source, data))
+            pos += length
+        else:
+            raise ValueError(f"invalid op {op} at {pos - 9}")
+    if len(out) != size:
+        raise ValueError(f"patched size {len(out)} != {size}")
+    return bytes(out)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("old", help="running firmware image")
+    parser.add_argument("new", help="new firmware image")
+    parser.add_argument("-o", "--output", required=True, help="delta image")
+    parser.add_argument("--raw", action="store_true", help="don't compress delta image")
+    args = parser.parse_args()
+
+    with open(args.old, "rb") as f:
+        old = f.read()
+    with open(args.new, "rb") as f:
+        new = f.read()
+
+    patch, stats = make_delta(old, new)
+    if apply_delta(old, patch) != new:
+        sys.exit("delta image verification failed")
+    data = patch if args.raw else zlib.compress(patch, 9)
+    with open(args.output, "wb") as f:
+        f.write(data)
+
+    print(
+        f"new image: {len(new)} bytes, copied: {stats[OP_COPY]}, "
+        f"added: {stats[OP_ADD]}, inserted: {stats[OP_INSERT]}"
+    )
+    print(f"delta image: {len(patch)} bytes, written: {len(data)} bytes")
+    print(f"md5 (0x3000:03): {hashlib.md5(new).hexdigest()}")
+
+
+if __name__ == "__main__":
+    main()
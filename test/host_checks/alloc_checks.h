@@ -0,0 +1,48 @@
+#pragma once
+// transmit path (DrvCanSend -> canbus, virtual bus loopback) must not allocate
+#include "host_checks.h"
+
+namespace esphome {
+namespace canopen {
+namespace host_checks {
+
+HOST_CHECK_CASE(alloc_transmit_path) {
+  VirtualBus bus;
+  CountingCanbus canbus;
+  TestNode sender(1), receiver(2);
+  sender.set_canbus(&canbus);
+  TPDO tpdo = {0, true};
+  uint32_t state = 0;
+  sender.od_add_state(1, CO_TUNSIGNED32, &state, 4, tpdo);
+  uint32_t commands = 0;
+  receiver.od_add_cmd(1, [&commands](void *buffer, uint32_t size) { commands++; });
+  sender.setup();
+  receiver.setup();
+
+  const int n = 1000;
+  uint8_t value = 1;
+  auto send_all = [&]() {
+    for (int i = 0; i < n; i++) {
+      sender.send({0x701, {0x05}, 1});  // heartbeat
+      sender.trig_tpdo(0);
+      sender.remote_entity_write_od(2, ENTITY_INDEX(1) + 2, 1, &value, 1);
+      bus.loop();
+    }
+  };
+  send_all();  // warm up, first calls may allocate (e.g. lazily initialized statics)
+
+  uint64_t before = allocations();
+  uint32_t frames = canbus.frames;
+  send_all();
+  uint64_t allocs = allocations() - before;
+  frames = canbus.frames - frames;
+
+  printf("alloc_transmit_path: %u frames sent, %llu heap allocations\n", frames, (unsigned long long) allocs);
+  HOST_CHECK_EQ(frames, 3 * n);
+  HOST_CHECK_EQ(commands, 2 * n);
+  HOST_CHECK_EQ(allocs, 0);
+}
+
+}  // namespace host_checks
+}  // namespace canopen
+}  // namespace esphome
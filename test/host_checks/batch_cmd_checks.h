@@ -0,0 +1,104 @@
+#pragma once
+// batched OD writer frames: frames on the bus for typical scenes, compared with one frame per command;
+// frames of senders not listed in od_writer_senders are not executed
+#include <memory>
+#include "host_checks.h"
+
+namespace esphome {
+namespace canopen {
+namespace host_checks {
+
+HOST_CHECK_CASE(batch_cmd_frame_count) {
+  const uint8_t nodes = 10, entities = 20;
+  VirtualBus bus;
+  CountingCanbus canbus;
+  TestNode sender(1);
+  sender.set_canbus(&canbus);
+  std::vector<std::unique_ptr<TestNode>> receivers;
+  // last value received by each node / entity
+  uint8_t values[nodes][entities + 1] = {};
+  uint32_t commands = 0;
+  for (uint8_t n = 0; n < nodes; n++) {
+    receivers.emplace_back(new TestNode(n + 2));
+    for (uint8_t entity_id = 1; entity_id <= entities; entity_id++) {
+      receivers[n]->od_add_cmd(entity_id, [&values, &commands, n, entity_id](void *buffer, uint32_t size) {
+        values[n][entity_id] = *(uint8_t *) buffer;
+        commands++;
+      });
+    }
+  }
+  sender.setup();
+  for (auto &receiver : receivers)
+    receiver->setup();
+
+  auto scene = [&](const char *name, uint8_t first_node, uint8_t last_node, uint8_t per_node, uint8_t value,
+                   bool broadcast) {
+    commands = 0;
+    uint32_t frames = canbus.frames;
+    for (uint8_t node_id = first_node; node_id <= last_node; node_id++) {
+      std::vector<EntityCmd> cmds;
+      for (uint8_t entity_id = 1; entity_id <= per_node; entity_id++)
+        cmds.push_back({entity_id, 0, value});
+      sender.remote_entity_write_od_batch(broadcast ? 0 : node_id, cmds);
+    }
+    bus.loop(2);
+    frames = canbus.frames - frames;
+    // single write frames address one node each
+    uint32_t single = (broadcast ? nodes : last_node - first_node + 1) * per_node;
+    printf("batch_cmd_frame_count: %-28s %3u frames, %3u with single writes\n", name, frames, single);
+    return frames;
+  };
+
+  // 20 commands to single node: 3 commands per frame
+  HOST_CHECK_EQ(scene("20 commands, 1 node", 2, 2, entities, 1, false), 7);
+  HOST_CHECK_EQ(commands, entities);
+  HOST_CHECK_EQ(values[0][entities], 1);
+
+  // 2 commands to each of 10 nodes
+  HOST_CHECK_EQ(scene("2 commands, 10 nodes", 2, nodes + 1, 2, 2, false), nodes);
+  HOST_CHECK_EQ(commands, 2 * nodes);
+  HOST_CHECK_EQ(values[nodes - 1][2], 2);
+  HOST_CHECK_EQ(values[0][3], 1);
+
+  // 20 commands broadcast to all nodes
+  HOST_CHECK_EQ(scene("20 commands, broadcast", 0, 0, entities, 3, true), 7);
+  HOST_CHECK_EQ(commands, nodes * entities);
+  for (uint8_t n = 0; n < nodes; n++)
+    HOST_CHECK_EQ(values[n][entities], 3);
+
+  // frame count with single writes, for comparison
+  uint32_t frames = canbus.frames;
+  uint8_t value = 4;
+  for (uint8_t entity_id = 1; entity_id <= entities; entity_id++)
+    sender.remote_entity_write_od(2, ENTITY_INDEX(entity_id) + 2, 1, &value, 1);
+  bus.loop(2);
+  HOST_CHECK_EQ(canbus.frames - frames, entities);
+  HOST_CHECK_EQ(values[0][entities], 4);
+}
+
+// TPDO payload of node 3 on its OD writer COB-ID looks like broadcast batch command
+HOST_CHECK_CASE(batch_cmd_od_writer_senders) {
+  VirtualBus bus;
+  TestNode sender(1), other(3), restricted(2), open(4);
+  uint8_t values[2] = {};
+  restricted.od_add_cmd(1, [&values](void *buffer, uint32_t size) { values[0] = *(uint8_t *) buffer; });
+  open.od_add_cmd(1, [&values](void *buffer, uint32_t size) { values[1] = *(uint8_t *) buffer; });
+  restricted.set_od_writer_senders({1});
+  for (auto node : {&sender, &other, &restricted, &open})
+    node->setup();
+
+  other.send({0x500 + 3, {0x80, 1, 0, 7}, 4});
+  bus.loop(2);
+  HOST_CHECK_EQ(values[0], 0);
+  // all senders are accepted by default
+  HOST_CHECK_EQ(values[1], 7);
+
+  sender.remote_entity_write_od_batch(0, {{1, 0, 5}});
+  bus.loop(2);
+  HOST_CHECK_EQ(values[0], 5);
+  HOST_CHECK_EQ(values[1], 5);
+}
+
+}  // namespace host_checks
+}  // namespace canopen
+}  // namespace esphome
@@ -0,0 +1,81 @@
+#pragma once
+// timer driver deadlines across 32-bit micros() wrap (every ~71 minutes)
+#include "host_checks.h"
+
+namespace esphome {
+namespace canopen {
+namespace host_checks {
+
+HOST_CHECK_CASE(clock_wrap) {
+  FakeClock clock;
+  clock.us = 0xFFFF0000;
+  HOST_CHECK_EQ(clock.now_us(), 0xFFFF0000ull);
+  clock.us = 0x10;
+  HOST_CHECK_EQ(clock.now_us(), 0x100000010ull);
+  clock.us = 0xFFFFFFFF;
+  HOST_CHECK_EQ(clock.now_us(), 0x1FFFFFFFFull);
+  clock.us = 0;
+  HOST_CHECK_EQ(clock.now_us(), 0x200000000ull);
+}
+
+HOST_CHECK_CASE(timer_driver_wrap) {
+  VirtualBus bus;
+  FakeClock clock;
+  clock.us = 0xFFFF0000;
+  TestNode node(1);
+  node.set_clock(&clock);
+  node.setup();
+
+  auto timer = node.node->If.Drv->Timer;
+  current_canopen = &node;
+  // deadline 100ms ahead, after the wrap
+  timer->Reload(100000);
+  clock.us = 0xFFFFFFF0;
+  HOST_CHECK_EQ(timer->Update(), 0);
+  HOST_CHECK_EQ(timer->Delay(), 100000 - 0xFFF0);
+  clock.us = 0x10;
+  HOST_CHECK_EQ(timer->Update(), 0);
+  HOST_CHECK_EQ(timer->Delay(), 100000 - 0x10010);
+  clock.us = 100000 - 0x10000 - 1;
+  HOST_CHECK_EQ(timer->Update(), 0);
+  HOST_CHECK_EQ(timer->Delay(), 1);
+  clock.us = 100000 - 0x10000;
+  HOST_CHECK_EQ(timer->Update(), 1);
+  HOST_CHECK_EQ(timer->Delay(), 0);
+  timer->Stop();
+  HOST_CHECK_EQ(timer->Update(), 0);
+  current_canopen = nullptr;
+}
+
+HOST_CHECK_CASE(heartbeat_producer_wrap) {
+  VirtualBus bus;
+  CountingCanbus canbus;
+  FakeClock clock;
+  // 5s before the wrap
+  clock.us = 0xFFFFFFFF - 5000000;
+  TestNode node(1);
+  node.set_canbus(&canbus);
+  node.set_clock(&clock);
+  node.set_heartbeat_interval(1000);
+  node.setup();
+
+  // 10s in 10ms steps
+  uint32_t max_per_second = 0, last_count = 0;
+  for (int i = 1; i <= 1000; i++) {
+    clock.us += 10000;
+    node.loop();
+    if (i % 100 == 0) {
+      uint32_t count = canbus.frames_by_id[0x701];
+      max_per_second = std::max(max_per_second, count - last_count);
+      last_count = count;
+    }
+  }
+  uint32_t heartbeats = canbus.frames_by_id[0x701];
+  printf("heartbeat_producer_wrap: %u heartbeats in 10s across micros() wrap\n", heartbeats);
+  HOST_CHECK(heartbeats >= 9 && heartbeats <= 11);
+  HOST_CHECK(max_per_second <= 2);
+}
+
+}  // namespace host_checks
+}  // namespace canopen
+}  // namespace esphome
@@ -0,0 +1,92 @@
+#pragma once
+// entity command dispatch: direct index (CmdTable) compared with previous implementations
+#include <algorithm>
+#include <map>
+#include "host_checks.h"
+
+namespace esphome {
+namespace canopen {
+namespace host_checks {
+
+HOST_CHECK_CASE(cmd_dispatch_benchmark) {
+  const uint32_t entities = 64, cmds = 4, rounds = 2000;
+  VirtualBus bus;
+  TestNode node(1);
+  uint32_t calls = 0, last_value = 0;
+  std::vector<uint32_t> keys;
+  for (uint32_t entity_id = 1; entity_id <= entities; entity_id++) {
+    for (uint32_t cmd = 0; cmd < cmds; cmd++) {
+      keys.push_back(node.od_add_cmd(entity_id, [&](void *buffer, uint32_t size) {
+        calls++;
+        last_value = *(uint8_t *) buffer;
+      }));
+    }
+  }
+  node.setup();
+
+  // baseline: map of handlers copied on every command write
+  std::map<uint32_t, CmdCallback> map_handlers;
+  // previous: sorted vector with binary search
+  std::vector<std::pair<uint32_t, CmdCallback>> sorted_handlers;
+  for (auto key : keys) {
+    auto cb = [&](void *buffer, uint32_t size) { calls++; };
+    map_handlers[key] = cb;
+    sorted_handlers.push_back({key, cb});
+  }
+  uint8_t value = 1;
+
+  auto bench = [&](const char *name, std::function<void(uint32_t)> dispatch) {
+    calls = 0;
+    uint64_t allocs = allocations();
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < rounds; i++) {
+      for (auto key : keys)
+        dispatch(key);
+    }
+    double seconds = elapsed_s(start);
+    allocs = allocations() - allocs;
+    uint32_t n = rounds * keys.size();
+    printf("cmd_dispatch_benchmark: %-24s %8.1f ns/cmd, %.2f allocations/cmd\n", name, seconds * 1e9 / n,
+           (double) allocs / n);
+    HOST_CHECK_EQ(calls, n);
+    return allocs;
+  };
+
+  bench("map copy (baseline)", [&](uint32_t key) {
+    auto handlers = map_handlers;
+    auto it = handlers.find(key);
+    if (it != handlers.end())
+      it->second(&value, 1);
+  });
+  bench("sorted vector", [&](uint32_t key) {
+    auto it = std::lower_bound(sorted_handlers.begin(), sorted_handlers.end(), key,
+                               [](const std::pair<uint32_t, CmdCallback> &a, uint32_t key) { return a.first < key; });
+    if (it != sorted_handlers.end() && it->first == key)
+      it->second(&value, 1);
+  });
+  auto allocs = bench("direct index", [&](uint32_t key) { node.dispatch_cmd(key, &value, 1); });
+  HOST_CHECK_EQ(allocs, 0);
+
+  // full write path: OD lookup, Cmd8Write, dispatch
+  allocs = bench("OD write + direct index", [&](uint32_t key) {
+    COObjWrValue(node.od.find(key), node.node, &value, 1);
+  });
+  HOST_CHECK_EQ(allocs, 0);
+
+  // unknown commands are ignored
+  calls = 0;
+  uint32_t missing_entity = entities + 1;
+  node.dispatch_cmd(ENTITY_CMD_KEY(missing_entity, 0), &value, 1);
+  node.dispatch_cmd(ENTITY_CMD_KEY(1, cmds), &value, 1);
+  node.dispatch_cmd(ENTITY_STATE_KEY(1, 0), &value, 1);
+  HOST_CHECK_EQ(calls, 0);
+
+  value = 7;
+  node.dispatch_cmd(ENTITY_CMD_KEY(entities, cmds - 1), &value, 1);
+  HOST_CHECK_EQ(calls, 1);
+  HOST_CHECK_EQ(last_value, 7);
+}
+
+}  // namespace host_checks
+}  // namespace canopen
+}  // namespace esphome
@@ -0,0 +1,168 @@
+#pragma once
+// delta OTA images: DeltaDecoder round trip of patches made by scripts/canopen_delta.py,
+// truncated and corrupted patches
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include "host_checks.h"
+
+#ifdef USE_CANOPEN_OTA
+#include "esphome/components/canopen/ota/delta.h"
+
+namespace esphome {
+namespace canopen {
+namespace host_checks {
+
+typedef std::vector<uint8_t> Bytes;
+
+struct DeltaResult {
+  bool ok;
+  bool complete;
+  Bytes image;
+};
+
+// feeds patch in SDO sized pieces, as OTA component does
+inline DeltaResult delta_apply(const Bytes &source, const Bytes &patch, size_t len) {
+  DeltaDecoder decoder;
+  DeltaResult result = {true, false, {}};
+  decoder.reset();
+  decoder.read_source = [&](uint32_t offset, uint8_t *buf, size_t n) {
+    if (offset > source.size() || n > source.size() - offset)
+      return false;
+    memcpy(buf, source.data() + offset, n);
+    return true;
+  };
+  decoder.write = [&](uint8_t *buf, size_t n) {
+    result.image.insert(result.image.end(), buf, buf + n);
+    return true;
+  };
+  for (size_t pos = 0; pos < len && result.ok;) {
+    auto n = decoder.feed(patch.data() + pos, std::min<size_t>(CO_SDO_BUF_BYTE, len - pos));
+    result.ok = n >= 0;
+    pos += n;
+    while (result.ok && decoder.busy())
+      result.ok = decoder.step(1024);
+  }
+  result.complete = result.ok && decoder.complete();
+  return result;
+}
+
+// offset of first command with given op, -1 if there is none
+inline int32_t delta_find_op(const Bytes &patch, uint8_t op) {
+  size_t pos = DeltaDecoder::MAGIC_SIZE + 4;
+  while (pos + 9 <= patch.size()) {
+    uint32_t len;
+    memcpy(&len, patch.data() + pos + 1, sizeof(len));
+    if (patch[pos] == op)
+      return pos;
+    pos += patch[pos] == DeltaDecoder::OP_INSERT ? 5 + len : 9 + (patch[pos] == DeltaDecoder::OP_ADD ? len : 0);
+  }
+  return -1;
+}
+
+inline void delta_check(const char *name, const Bytes &source, const Bytes &image, const Bytes &patch) {
+  auto start = std::chrono::steady_clock::now();
+  auto result = delta_apply(source, patch, patch.size());
+  printf("delta_image: %s, %u bytes patched with %u bytes in %.1f ms\n", name, (unsigned) image.size(),
+         (unsigned) patch.size(), elapsed_s(start) * 1e3);
+  HOST_CHECK(result.ok && result.complete);
+  HOST_CHECK(result.image == image);
+
+  // truncated patch is reported as incomplete (OTA end fails)
+  result = delta_apply(source, patch, patch.size() / 2);
+  HOST_CHECK(result.ok && !result.complete);
+  result = delta_apply(source, patch, patch.size() - 1);
+  HOST_CHECK(!result.complete);
+
+  // invalid op
+  auto corrupted = patch;
+  corrupted[DeltaDecoder::MAGIC_SIZE + 4] = 0x7f;
+  HOST_CHECK(!delta_apply(source, corrupted, corrupted.size()).ok);
+
+  // command longer than announced image size
+  corrupted = patch;
+  uint32_t size = 16;
+  memcpy(corrupted.data() + DeltaDecoder::MAGIC_SIZE, &size, sizeof(size));
+  HOST_CHECK(!delta_apply(source, corrupted, corrupted.size()).ok);
+
+  // COPY from outside of running image
+  auto copy = delta_find_op(patch, DeltaDecoder::OP_COPY);
+  HOST_CHECK(copy >= 0);
+  if (copy >= 0) {
+    corrupted = patch;
+    uint32_t offset = source.size();
+    memcpy(corrupted.data() + copy + 5, &offset, sizeof(offset));
+    HOST_CHECK(!delta_apply(source, corrupted, corrupted.size()).ok);
+  }
+
+  // corrupted data is decoded, wrong image is rejected by MD5 check of OTA component
+  auto insert = delta_find_op(patch, DeltaDecoder::OP_INSERT);
+  HOST_CHECK(insert >= 0);
+  if (insert >= 0) {
+    corrupted = patch;
+    corrupted[insert + 5] ^= 0x01;
+    result = delta_apply(source, corrupted, corrupted.size());
+    HOST_CHECK(result.complete && result.image != image);
+  }
+}
+
+inline bool read_file(const std::string &path, Bytes &data) {
+  std::ifstream f(path, std::ios::binary);
+  data.assign(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+  return f.good() || f.eof();
+}
+
+HOST_CHECK_CASE(delta_image) {
+  // synthetic patch: COPY, ADD, INSERT, COPY of moved data
+  Bytes source(64 * 1024), image, patch = {'C', 'D', 'P', '1', 0, 0, 0, 0};
+  uint32_t x = 7;
+  for (auto &b : source) {
+    x = x * 1103515245 + 12345;
+    b = x >> 24;
+  }
+  auto op = [&](uint8_t code, uint32_t len, uint32_t src) {
+    patch.push_back(code);
+    patch.insert(patch.end(), (uint8_t *) &len, (uint8_t *) &len + 4);
+    if (code != DeltaDecoder::OP_INSERT)
+      patch.insert(patch.end(), (uint8_t *) &src, (uint8_t *) &src + 4);
+  };
+  op(DeltaDecoder::OP_COPY, 10000, 0);
+  image.insert(image.end(), source.begin(), source.begin() + 10000);
+  op(DeltaDecoder::OP_ADD, 300, 10000);
+  for (uint32_t i = 0; i < 300; i++) {
+    patch.push_back(i % 7 == 0 ? 4 : 0);
+    image.push_back(source[10000 + i] + patch.back());
+  }
+  op(DeltaDecoder::OP_INSERT, 500, 0);
+  for (uint32_t i = 0; i < 500; i++) {
+    patch.push_back(i);
+    image.push_back(i);
+  }
+  op(DeltaDecoder::OP_COPY, 20000, 40000);
+  image.insert(image.end(), source.begin() + 40000, source.begin() + 60000);
+  uint32_t size = image.size();
+  memcpy(patch.data() + DeltaDecoder::MAGIC_SIZE, &size, sizeof(size));
+  delta_check("synthetic", source, image, patch);
+
+  // real firmware images and patch made by scripts/canopen_delta.py --raw (CI)
+  const char *dir = getenv("CANOPEN_DELTA_DIR");
+  if (!dir) {
+    printf("delta_image: CANOPEN_DELTA_DIR not set, firmware image patch skipped\n");
+    return;
+  }
+  Bytes old_image, new_image, firmware_patch;
+  HOST_CHECK(read_file(std::string(dir) + "/old.bin", old_image) && !old_image.empty());
+  HOST_CHECK(read_file(std::string(dir) + "/new.bin", new_image) && !new_image.empty());
+  HOST_CHECK(read_file(std::string(dir) + "/patch.bin", firmware_patch) && !firmware_patch.empty());
+  if (old_image.empty() || new_image.empty() || firmware_patch.empty())
+    return;
+  delta_check("firmware", old_image, new_image, firmware_patch);
+}
+
+}  // namespace host_checks
+}  // namespace canopen
+}  // namespace esphome
+#endif
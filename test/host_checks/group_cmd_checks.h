@@ -0,0 +1,56 @@
+#pragma once
+// group commands: single frame addressing entities on many nodes
+#include <memory>
+#include "host_checks.h"
+
+namespace esphome {
+namespace canopen {
+namespace host_checks {
+
+HOST_CHECK_CASE(group_cmd) {
+  const uint8_t nodes = 4;
+  VirtualBus bus;
+  CountingCanbus canbus;
+  TestNode sender(1);
+  sender.set_canbus(&canbus);
+  std::vector<std::unique_ptr<TestNode>> receivers;
+  uint32_t values[nodes][3] = {};
+  for (uint8_t n = 0; n < nodes; n++) {
+    receivers.emplace_back(new TestNode(n + 2));
+    receivers[n]->od_add_cmd(1, [&values, n](void *buffer, uint32_t size) { values[n][1] = *(uint8_t *) buffer; });
+    receivers[n]->od_add_cmd(
+        2, [&values, n](void *buffer, uint32_t size) { values[n][2] = *(uint16_t *) buffer; }, CO_TCMD16);
+    // entity 1 of every node in group 5, even nodes in group 6
+    receivers[n]->add_group(5, 1);
+    if (n % 2 == 0)
+      receivers[n]->add_group(6);
+  }
+  sender.setup();
+  for (auto &receiver : receivers)
+    receiver->setup();
+
+  HOST_CHECK(sender.send_entity_cmd(EntityGroup{5}, 0, true));
+  bus.loop(2);
+  HOST_CHECK_EQ(canbus.frames, 1);
+  for (uint8_t n = 0; n < nodes; n++) {
+    HOST_CHECK_EQ(values[n][1], 1);
+    HOST_CHECK_EQ(values[n][2], 0);
+  }
+
+  // entity 2 on nodes of group 6, 16-bit value
+  HOST_CHECK(sender.send_entity_cmd(EntityGroup{6}, 2, (uint16_t) 1000));
+  bus.loop(2);
+  HOST_CHECK_EQ(canbus.frames, 2);
+  for (uint8_t n = 0; n < nodes; n++)
+    HOST_CHECK_EQ(values[n][2], (n % 2 == 0 ? 1000 : 0));
+
+  // group 0 is reserved, values are 1 or 2 bytes
+  uint32_t value = 0;
+  HOST_CHECK(!sender.send_entity_cmd(EntityGroup{0}, 0, true));
+  HOST_CHECK(!sender.remote_group_write_od(5, 0, 0, &value, 3));
+  HOST_CHECK_EQ(canbus.frames, 2);
+}
+
+}  // namespace host_checks
+}  // namespace canopen
+}  // namespace esphome
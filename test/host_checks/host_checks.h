@@ -0,0 +1,162 @@
+#pragma once
+// Runtime checks and benchmarks run by test/host_checks.yaml on host platform.
+// Checks register themselves with HOST_CHECK_CASE, run() executes them all and
+// returns number of failed assertions, which is used as program exit code.
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <new>
+#include <vector>
+#include "esphome/components/canopen/canopen.h"
+
+namespace esphome {
+namespace canopen {
+namespace host_checks {
+
+struct Case {
+  const char *name;
+  void (*fn)();
+};
+
+inline std::vector<Case> &cases() {
+  static std::vector<Case> all;
+  return all;
+}
+
+inline int &failures() {
+  static int count = 0;
+  return count;
+}
+
+struct Register {
+  Register(const char *name, void (*fn)()) { cases().push_back({name, fn}); }
+};
+
+#define HOST_CHECK_CASE(name) \
+  static void name(); \
+  static esphome::canopen::host_checks::Register name##_register(#name, name); \
+  static void name()
+
+#define HOST_CHECK(cond) \
+  do { \
+    if (!(cond)) { \
+      printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+      esphome::canopen::host_checks::failures()++; \
+    } \
+  } while (0)
+
+#define HOST_CHECK_EQ(a, b) \
+  do { \
+    long long _a = (long long) (a), _b = (long long) (b); \
+    if (_a != _b) { \
+      printf("%s:%d: check failed: %s == %s (%lld != %lld)\n", __FILE__, __LINE__, #a, #b, _a, _b); \
+      esphome::canopen::host_checks::failures()++; \
+    } \
+  } while (0)
+
+// heap allocations made by the program, see operator new below
+inline uint64_t &allocations() {
+  static uint64_t count = 0;
+  return count;
+}
+
+inline double elapsed_s(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// exposes internals of CanopenComponent to checks
+class TestNode : public CanopenComponent {
+ public:
+  explicit TestNode(uint32_t node_id) : CanopenComponent(node_id) {}
+  using CanopenComponent::bus_stats;
+  using CanopenComponent::entities;
+  using CanopenComponent::node;
+  using CanopenComponent::od;
+  using CanopenComponent::recv_frames;
+  using CanopenComponent::tpdo_sent;
+
+  // sends frame as if it was sent by canopen-stack of this node
+  void send(const CO_IF_FRM &frame) {
+    CO_IF_FRM frm = frame;
+    current_canopen = this;
+    node->If.Drv->Can->Send(&frm);
+    current_canopen = nullptr;
+  }
+};
+
+// entity with single 32-bit state, set up in CanopenComponent::setup() like entities from yaml
+class TestEntity : public BaseCanopenEntity {
+ public:
+  uint32_t key = 0;
+  TestEntity(uint32_t entity_id, TPDO tpdo) : BaseCanopenEntity(entity_id, tpdo) {}
+  void setup(CanopenComponent *canopen) override {
+    key = canopen->od_add_state(entity_id, CO_TUNSIGNED32, nullptr, 4, tpdo);
+  }
+  void publish(CanopenComponent *canopen, uint32_t value) { od_set_state(canopen, key, &value, 4); }
+};
+
+// canbus driver counting frames instead of sending them
+class CountingCanbus : public canbus::Canbus {
+ public:
+  uint32_t frames = 0;
+  uint32_t frames_by_id[2048] = {};
+
+ protected:
+  bool setup_internal() override { return true; }
+  canbus::Error send_message(struct canbus::CanFrame *frame) override {
+    frames++;
+    frames_by_id[frame->can_id & 0x7ff]++;
+    return canbus::ERROR_OK;
+  }
+  canbus::Error read_message(struct canbus::CanFrame *frame) override { return canbus::ERROR_NOMSG; }
+};
+
+// time source controlled by checks
+class FakeClock : public MonotonicClock {
+ public:
+  uint32_t us = 0;
+
+ protected:
+  uint32_t raw_us() override { return us; }
+};
+
+// nodes set up within scope are connected only with each other, not with nodes from yaml
+class VirtualBus {
+  std::vector<CanopenComponent *> saved;
+
+ public:
+  VirtualBus() : saved(all_instances) { all_instances.clear(); }
+  ~VirtualBus() { all_instances = saved; }
+  void loop(int times = 1) {
+    for (int i = 0; i < times; i++) {
+      for (auto node : all_instances)
+        node->loop();
+    }
+  }
+};
+
+inline int run() {
+  for (auto &c : cases()) {
+    int before = failures();
+    c.fn();
+    printf("%s: %s\n", c.name, failures() == before ? "OK" : "FAILED");
+  }
+  printf("%d checks, %d failures\n", (int) cases().size(), failures());
+  return failures() ? 1 : 0;
+}
+
+}  // namespace host_checks
+}  // namespace canopen
+}  // namespace esphome
+
+// this header is included once, in main.cpp generated by esphome
+void *operator new(size_t size) {
+  esphome::canopen::host_checks::allocations()++;
+  void *ptr = malloc(size ? size : 1);
+  if (!ptr)
+    throw std::bad_alloc();
+  return ptr;
+}
+void operator delete(void *ptr) noexcept { free(ptr); }
+void operator delete(void *ptr, size_t) noexcept { free(ptr); }
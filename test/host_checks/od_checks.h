@@ -0,0 +1,33 @@
+#pragma once
+// object dictionary lookup index must stay consistent with entries added after freeze()
+#include "host_checks.h"
+
+namespace esphome {
+namespace canopen {
+namespace host_checks {
+
+HOST_CHECK_CASE(od_modified_after_freeze) {
+  ObjectDictionary od(16);
+  od.append(CO_KEY(0x1000, 0, CO_OBJ_D___R_), CO_TUNSIGNED32, 1);
+  od.append(CO_KEY(0x1001, 0, CO_OBJ_D___R_), CO_TUNSIGNED8, 2);
+  od.freeze();
+  HOST_CHECK(od.is_frozen());
+  HOST_CHECK(od.find(CO_DEV(0x1001, 0)));
+
+  od.append(CO_KEY(0x2000, 0, CO_OBJ_D___R_), CO_TUNSIGNED8, 3);
+  HOST_CHECK(!od.is_frozen());
+  auto obj = od.find(CO_DEV(0x2000, 0));
+  HOST_CHECK(obj && obj->Data == 3);
+
+  od.freeze();
+  od.add_update(CO_KEY(0x1002, 0, CO_OBJ_D___R_), CO_TUNSIGNED8, 4);
+  HOST_CHECK(!od.is_frozen());
+  od.freeze();
+  for (uint16_t index : {0x1000, 0x1001, 0x1002, 0x2000})
+    HOST_CHECK(od.find(CO_DEV(index, 0)));
+  HOST_CHECK(!od.find(CO_DEV(0x1003, 0)));
+}
+
+}  // namespace host_checks
+}  // namespace canopen
+}  // namespace esphome
@@ -0,0 +1,249 @@
+#pragma once
+// OTA: end() result covers decompression, flash writes and MD5 check; wall clock time of image processing;
+// time spent in SDO handler is bounded with slow flash
+#include "host_checks.h"
+
+#ifdef USE_CANOPEN_OTA
+#include <cstring>
+#include <memory>
+#include <thread>
+#include "esphome/components/canopen/fw.h"
+#include "esphome/components/md5/md5.h"
+
+namespace esphome {
+namespace canopen {
+namespace host_checks {
+
+// OTA backend writing image to RAM
+class RamOtaBackend : public ota::OTABackend {
+ public:
+  std::vector<uint8_t> image;
+  bool ended = false;
+  uint32_t write_delay_ms = 0;  // emulates slow flash
+  ota::OTAResponseTypes begin(size_t image_size) override {
+    image.clear();
+    image.reserve(image_size);
+    ended = false;
+    return ota::OTA_RESPONSE_OK;
+  }
+  void set_update_md5(const char *md5) override {}
+  ota::OTAResponseTypes write(uint8_t *data, size_t len) override {
+    if (write_delay_ms)
+      std::this_thread::sleep_for(std::chrono::milliseconds(write_delay_ms));
+    image.insert(image.end(), data, data + len);
+    return ota::OTA_RESPONSE_OK;
+  }
+  ota::OTAResponseTypes end() override {
+    ended = true;
+    return ota::OTA_RESPONSE_OK;
+  }
+  void abort() override {}
+};
+
+struct OtaImage {
+  std::vector<uint8_t> data;
+  std::vector<uint8_t> compressed;
+  char md5[33];
+
+  explicit OtaImage(size_t size) {
+    // firmware-like content: compressible, but not trivially
+    uint32_t x = 1;
+    for (size_t i = 0; i < size; i++) {
+      x = x * 1103515245 + 12345;
+      data.push_back(i % 64 < 48 ? (uint8_t) (i / 64) : (uint8_t) (x >> 24));
+    }
+    md5::MD5Digest digest;
+    digest.init();
+    digest.add(data.data(), data.size());
+    digest.calculate();
+    digest.get_hex(md5);
+#ifdef OTA_COMPRESSION
+    mz_ulong len = mz_compressBound(size);
+    compressed.resize(len);
+    mz_compress2(compressed.data(), &len, data.data(), size, 6);
+    compressed.resize(len);
+#else
+    compressed = data;
+#endif
+  }
+};
+
+// SDO handler writes image in segments of SDO buffer size
+inline ota::OTAResponseTypes ota_upload(CanopenOTAComponent &ota, const std::vector<uint8_t> &image, size_t len,
+                                        const char *md5) {
+  auto ret = ota.begin(image.size());
+  for (size_t pos = 0; pos < len && ret == ota::OTA_RESPONSE_OK; pos += CO_SDO_BUF_BYTE) {
+    ret = ota.write((uint8_t *) image.data() + pos, std::min<size_t>(CO_SDO_BUF_BYTE, len - pos));
+  }
+  return ret == ota::OTA_RESPONSE_OK ? ota.end(md5) : ret;
+}
+
+HOST_CHECK_CASE(ota_end_verifies_image) {
+  CanopenOTAComponent ota;
+  ota.disable_ota_reboot = true;
+  ota.setup();
+  auto backend = static_cast<RamOtaBackend *>(ota.backend.get());
+  OtaImage image(1024 * 1024);
+
+  // image is processed completely before end() returns, without loop() calls
+  auto start = std::chrono::steady_clock::now();
+  HOST_CHECK_EQ(ota_upload(ota, image.compressed, image.compressed.size(), image.md5), ota::OTA_RESPONSE_OK);
+  double seconds = elapsed_s(start);
+  printf("ota_end_verifies_image: %u kB image (%u kB compressed) processed in %.1f ms, %.1f MB/s\n",
+         (unsigned) image.data.size() / 1024, (unsigned) image.compressed.size() / 1024, seconds * 1e3,
+         image.data.size() / seconds / 1e6);
+  HOST_CHECK(backend->image == image.data);
+  HOST_CHECK(!strcmp(ota.get_image_md5(), image.md5));
+  HOST_CHECK(!ota.in_progress());
+
+  // wrong MD5 is reported by end(), backend is not finalized
+  char bad_md5[33];
+  strcpy(bad_md5, image.md5);
+  bad_md5[0] = bad_md5[0] == '0' ? '1' : '0';
+  HOST_CHECK(ota_upload(ota, image.compressed, image.compressed.size(), bad_md5) != ota::OTA_RESPONSE_OK);
+  HOST_CHECK(!backend->ended);
+  HOST_CHECK(!ota.in_progress());
+
+  // truncated image
+  HOST_CHECK(ota_upload(ota, image.compressed, image.compressed.size() / 2, image.md5) != ota::OTA_RESPONSE_OK);
+  HOST_CHECK(!backend->ended);
+
+  // corrupted data
+  auto corrupted = image.compressed;
+  for (size_t i = corrupted.size() / 2; i < corrupted.size() / 2 + 64; i++)
+    corrupted[i] ^= 0x5a;
+  HOST_CHECK(ota_upload(ota, corrupted, corrupted.size(), image.md5) != ota::OTA_RESPONSE_OK);
+  HOST_CHECK(!backend->ended);
+}
+
+// with flash slower than SDO transfer, SDO handler gives up waiting for buffer space after CANOPEN_OTA_HANDLER_MS
+// (segment is rejected, update continues), image which can't be finished in end() is finished in loop()
+HOST_CHECK_CASE(ota_handler_time_bounded) {
+  CanopenOTAComponent ota;
+  ota.disable_ota_reboot = true;
+  ota.setup();
+  auto backend = static_cast<RamOtaBackend *>(ota.backend.get());
+  backend->write_delay_ms = CANOPEN_OTA_HANDLER_MS + 20;
+  OtaImage image(48 * 1024);
+  const auto &data = image.compressed;
+
+  for (bool good_md5 : {true, false}) {
+    char md5[33];
+    strcpy(md5, image.md5);
+    if (!good_md5)
+      md5[0] = md5[0] == '0' ? '1' : '0';
+    HOST_CHECK_EQ(ota.begin(image.data.size()), ota::OTA_RESPONSE_OK);
+    double max_handler_s = 0;
+    uint32_t rejected = 0;
+    auto ret = ota::OTA_RESPONSE_OK;
+    for (size_t pos = 0; pos < data.size() && ret == ota::OTA_RESPONSE_OK;) {
+      size_t len = std::min<size_t>(CO_SDO_BUF_BYTE, data.size() - pos);
+      auto start = std::chrono::steady_clock::now();
+      auto write_ret = ota.write((uint8_t *) data.data() + pos, len);
+      if (write_ret == ota::OTA_RESPONSE_OK && pos + len == data.size())
+        ret = ota.end(md5);
+      max_handler_s = std::max(max_handler_s, elapsed_s(start));
+      if (write_ret == ota::OTA_RESPONSE_OK) {
+        pos += len;
+      } else {
+        // master resumes after a while, meanwhile loop() makes progress
+        rejected++;
+        HOST_CHECK(ota.in_progress());
+        ota.loop();
+      }
+    }
+    HOST_CHECK_EQ(ret, ota::OTA_RESPONSE_OK);
+    HOST_CHECK(rejected > 0);
+    // single flash write may overrun the limit
+    HOST_CHECK(max_handler_s * 1e3 < CANOPEN_OTA_HANDLER_MS + 2 * backend->write_delay_ms);
+
+    // result is polled in 0x3000:0A
+    HOST_CHECK_EQ(ota.state, CanopenOTAComponent::STATE_FINISHING);
+    for (int i = 0; i < 1000 && ota.state == CanopenOTAComponent::STATE_FINISHING; i++)
+      ota.loop();
+    if (good_md5) {
+      HOST_CHECK_EQ(ota.state, CanopenOTAComponent::STATE_DONE);
+      HOST_CHECK_EQ(ota.state_error, 0);
+      HOST_CHECK(backend->image == image.data);
+    } else {
+      HOST_CHECK_EQ(ota.state, CanopenOTAComponent::STATE_FAILED);
+      HOST_CHECK(ota.state_error != 0);
+    }
+  }
+}
+
+// 0x3000:04 downloads as seen by FW_IMAGE object type, resumed transfer continues at 0x3000:06 offset
+HOST_CHECK_CASE(ota_resume_transfer) {
+  VirtualBus bus;
+  CanopenOTAComponent ota;
+  ota.disable_ota_reboot = true;
+  ota.setup();
+  TestNode node(2);
+  node.set_ota(&ota);
+  node.setup();
+  auto backend = static_cast<RamOtaBackend *>(ota.backend.get());
+  auto image_obj = node.od.find(CO_DEV(0x3000, 4));
+  auto ctrl_obj = node.od.find(CO_DEV(0x3000, 1));
+  HOST_CHECK(image_obj && ctrl_obj);
+  if (!image_obj || !ctrl_obj)
+    return;
+
+  OtaImage image(256 * 1024);
+  FirmwareObj.size = image.data.size();
+  md5::MD5Digest digest;
+  digest.init();
+  digest.add(image.data.data(), image.data.size());
+  digest.calculate();
+  digest.get_bytes(FirmwareObj.md5);
+
+  uint32_t size = image.compressed.size(), half = size / 2;
+  // SDO download of remaining data starting at `from`, interrupted at `to`;
+  // stack may query size before or after reset
+  auto transfer = [&](uint32_t from, uint32_t to, bool size_first) {
+    if (size_first)
+      FwImageSize(image_obj, node.node, size - from);
+    HOST_CHECK_EQ(FwImageReset(image_obj, node.node, 0), CO_ERR_NONE);
+    if (!size_first)
+      FwImageSize(image_obj, node.node, size - from);
+    HOST_CHECK_EQ(FirmwareObj.domain.Offset, from);
+    CO_ERR err = CO_ERR_NONE;
+    for (uint32_t pos = from; pos < to && err == CO_ERR_NONE; pos += CO_SDO_BUF_BYTE)
+      err = FwImageWrite(image_obj, node.node, image.compressed.data() + pos,
+                         std::min<uint32_t>(CO_SDO_BUF_BYTE, to - pos));
+    return err;
+  };
+  auto resume = [&]() {
+    uint32_t command = FW_CTRL_RESUME;
+    return FwCtrlWrite(ctrl_obj, node.node, &command, sizeof(command));
+  };
+
+  for (bool size_first : {true, false}) {
+    // interrupted transfer, resumed from received offset
+    HOST_CHECK_EQ(transfer(0, half, size_first), CO_ERR_NONE);
+    HOST_CHECK(!backend->ended);
+    HOST_CHECK_EQ(resume(), CO_ERR_NONE);
+    HOST_CHECK_EQ(transfer(half, size, size_first), CO_ERR_NONE);
+    HOST_CHECK(backend->image == image.data);
+    HOST_CHECK(!strcmp(ota.get_image_md5(), image.md5));
+
+    // resume is used by single transfer: transfer aborted right after reset doesn't turn next upload into resume
+    HOST_CHECK_EQ(transfer(0, half, size_first), CO_ERR_NONE);
+    HOST_CHECK_EQ(resume(), CO_ERR_NONE);
+    HOST_CHECK_EQ(transfer(half, half, size_first), CO_ERR_NONE);
+    HOST_CHECK_EQ(transfer(0, size, size_first), CO_ERR_NONE);
+    HOST_CHECK(backend->image == image.data);
+  }
+}
+
+}  // namespace host_checks
+}  // namespace canopen
+
+#ifdef USE_HOST
+namespace ota {
+// host platform has no OTA backend of its own
+std::unique_ptr<OTABackend> make_ota_backend() { return std::make_unique<canopen::host_checks::RamOtaBackend>(); }
+}  // namespace ota
+#endif
+
+}  // namespace esphome
+#endif
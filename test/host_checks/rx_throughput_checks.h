@@ -0,0 +1,95 @@
+#pragma once
+// received frames throughput: frames processed one per loop() compared with batched processing;
+// rx filter follows RPDO COB-IDs written with OD writer frames
+#include "host_checks.h"
+
+namespace esphome {
+namespace canopen {
+namespace host_checks {
+
+HOST_CHECK_CASE(rx_throughput_benchmark) {
+  VirtualBus bus;
+  TestNode sender(1), receiver(2);
+  uint32_t commands = 0;
+  receiver.od_add_cmd(1, [&commands](void *buffer, uint32_t size) { commands++; });
+  receiver.od_add_cmd(2, [&commands](void *buffer, uint32_t size) { commands++; });
+  sender.setup();
+  receiver.setup();
+
+  // typical traffic seen by a node: commands addressed to it, frames of other nodes
+  // which are dropped by rx filter, SYNC and SDO requests
+  const CO_IF_FRM traffic[] = {
+      {0x501, {0x02, 0x01, 0x22, 0x20, 0x01}, 5},                    // OD writer, entity 2 cmd 0
+      {0x181, {0x01, 0x02, 0x03, 0x04}, 4},                          // TPDO of node 1, not mapped
+      {0x701, {0x05}, 1},                                            // heartbeat of node 1, not consumed
+      {0x501, {0x80, 0x02, 0x00, 0x04}, 4},                          // OD writer batch, broadcast
+      {0x080, {}, 0},                                                // SYNC
+      {0x602, {0x40, 0x00, 0x10, 0x00}, 8},                          // SDO upload 0x1000:00
+      {0x281, {0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08}, 8},  // TPDO of node 1, not mapped
+      {0x501, {0x02, 0x01, 0x12, 0x20, 0x00}, 5},                    // OD writer, entity 1 cmd 0
+  };
+  const uint32_t traffic_n = sizeof(traffic) / sizeof(traffic[0]), commands_per_round = 3;
+  const uint32_t rounds = 20000;
+
+  auto bench = [&](const char *name, uint32_t burst) {
+    commands = 0;
+    uint32_t rx_frames = receiver.bus_stats.rx_frames, overflows = receiver.recv_frames.overflows;
+    auto start = std::chrono::steady_clock::now();
+    uint32_t sent = 0;
+    for (uint32_t i = 0; i < rounds; i++) {
+      for (auto &frame : traffic) {
+        sender.send(frame);
+        if (++sent % burst == 0)
+          bus.loop();
+      }
+    }
+    bus.loop(2);
+    double seconds = elapsed_s(start);
+    printf("rx_throughput_benchmark: %-28s %9.0f frames/s\n", name, sent / seconds);
+    HOST_CHECK_EQ(commands, rounds * commands_per_round);
+    HOST_CHECK_EQ(receiver.recv_frames.overflows, overflows);
+    HOST_CHECK(receiver.recv_frames.empty());
+    return receiver.bus_stats.rx_frames - rx_frames;
+  };
+
+  // before: frames were processed one by one as they arrived
+  uint32_t processed = bench("one frame per loop()", 1);
+  // after: frames queued between loop() calls are processed in single batch
+  HOST_CHECK_EQ(bench("batched, 16 frames per loop()", CANOPEN_RX_BATCH), processed);
+  // frames of other nodes don't enter the queue
+  HOST_CHECK_EQ(processed, rounds * (traffic_n - 3));
+}
+
+HOST_CHECK_CASE(rx_filter_rpdo_od_writer) {
+  VirtualBus bus;
+  TestNode sender(1), receiver(2), source(5);
+  sender.setup();
+  receiver.setup();
+  source.setup();
+  auto received = [&](uint32_t cob_id) {
+    uint32_t rx_frames = receiver.bus_stats.rx_frames;
+    source.send({cob_id, {1, 2, 3, 4}, 4});
+    bus.loop(2);
+    return receiver.bus_stats.rx_frames - rx_frames;
+  };
+  HOST_CHECK_EQ(received(0x185), 0);
+
+  // RPDO 0 of node 2 configured remotely to receive TPDO 0 of node 5
+  uint8_t entries = 2;
+  uint32_t cob_id = 0x185;
+  HOST_CHECK(sender.remote_entity_write_od(2, 0x1400, 0, &entries, 1));
+  HOST_CHECK(sender.remote_entity_write_od(2, 0x1400, 1, &cob_id, 4));
+  bus.loop(2);
+  HOST_CHECK_EQ(received(0x185), 1);
+
+  // the same written locally
+  cob_id = 0x285;
+  HOST_CHECK(receiver.remote_entity_write_od(2, 0x1400, 1, &cob_id, 4));
+  bus.loop(2);
+  HOST_CHECK_EQ(received(0x285), 1);
+  HOST_CHECK_EQ(received(0x185), 0);
+}
+
+}  // namespace host_checks
+}  // namespace canopen
+}  // namespace esphome
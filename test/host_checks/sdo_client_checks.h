@@ -0,0 +1,62 @@
+#pragma once
+// SDO client: received size of uploads, requests on unconfigured channels
+#include <cstring>
+#include "host_checks.h"
+
+namespace esphome {
+namespace canopen {
+namespace host_checks {
+
+HOST_CHECK_CASE(sdo_client_upload_size) {
+  VirtualBus bus;
+  TestNode client(1), server(2);
+  client.set_heartbeat_interval(1500);
+  server.set_heartbeat_interval(1500);
+  client.setup();
+  server.setup();
+
+  auto sdo = client.get_sdo_client();
+  uint32_t done = 0;
+  // segmented: device name, shorter than requested buffer
+  std::string name = App.get_name();
+  sdo->upload(2, CO_DEV(0x1008, 0), 64, [&](SdoRequest &req, uint32_t code) {
+    done++;
+    HOST_CHECK_EQ(code, 0);
+    HOST_CHECK_EQ(req.size, name.size());
+    HOST_CHECK_EQ(req.data.size(), 64);
+    HOST_CHECK(!memcmp(req.data.data(), name.data(), name.size()));
+  });
+  // expedited: 2-byte heartbeat interval in 4-byte buffer
+  sdo->upload(2, CO_DEV(0x1017, 0), 4, [&](SdoRequest &req, uint32_t code) {
+    done++;
+    HOST_CHECK_EQ(code, 0);
+    HOST_CHECK_EQ(req.size, 2);
+    uint16_t value;
+    memcpy(&value, req.data.data(), sizeof(value));
+    HOST_CHECK_EQ(value, 1500);
+  });
+  bus.loop(20);
+  HOST_CHECK_EQ(done, 2);
+}
+
+HOST_CHECK_CASE(csdo_unconfigured_channel) {
+  VirtualBus bus;
+  CountingCanbus canbus;
+  TestNode node(1);
+  node.set_canbus(&canbus);
+  node.setup();
+
+  uint32_t abort_code = 0;
+  node.csdo_recv(0, CO_DEV(0x1017, 0), [&](uint32_t value, uint32_t code) { abort_code = code; });
+  uint8_t data[2] = {};
+  node.csdo_send_data(0, CO_DEV(0x1017, 0), data, sizeof(data));
+  bus.loop(5);
+  HOST_CHECK_EQ(abort_code, SDO_ABORT_GENERAL);
+  // nothing is sent with COB-ID 0x000 (NMT)
+  HOST_CHECK_EQ(canbus.frames_by_id[0], 0);
+  HOST_CHECK(node.get_sdo_client()->is_idle());
+}
+
+}  // namespace host_checks
+}  // namespace canopen
+}  // namespace esphome
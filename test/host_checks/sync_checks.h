@@ -0,0 +1,112 @@
+#pragma once
+// SYNC producer and synchronous TPDO bookkeeping
+#include "host_checks.h"
+
+namespace esphome {
+namespace canopen {
+namespace host_checks {
+
+class SyncTestNode : public TestNode {
+ public:
+  using TestNode::TestNode;
+  using CanopenComponent::process_sync;
+  using CanopenComponent::sync_count;
+  using CanopenComponent::sync_received;
+};
+
+// high frequency loop is requested only shortly before SYNC is due, not while SYNC producer is idle
+HOST_CHECK_CASE(sync_producer_high_frequency_loop) {
+  VirtualBus bus;
+  CountingCanbus canbus;
+  FakeClock clock;
+  TestNode node(1);
+  node.set_canbus(&canbus);
+  node.set_clock(&clock);
+  node.set_sync_producer(100);
+  node.setup();
+
+  CONmtSetMode(&node.node->Nmt, CO_PREOP);
+  for (int i = 0; i < 10; i++) {
+    clock.us += 10000;
+    bus.loop();
+    HOST_CHECK(!HighFrequencyLoopRequester::is_high_frequency());
+  }
+  HOST_CHECK_EQ(canbus.frames_by_id[0x080], 0);
+
+  CONmtSetMode(&node.node->Nmt, CO_OPERATIONAL);
+  bus.loop();
+  HOST_CHECK_EQ(canbus.frames_by_id[0x080], 1);
+  HOST_CHECK(!HighFrequencyLoopRequester::is_high_frequency());
+  clock.us += 90000;
+  bus.loop();
+  HOST_CHECK(HighFrequencyLoopRequester::is_high_frequency());
+  clock.us += 10000;
+  bus.loop();
+  HOST_CHECK_EQ(canbus.frames_by_id[0x080], 2);
+
+  // leaving operational state stops SYNC producer and high frequency loop
+  CONmtSetMode(&node.node->Nmt, CO_PREOP);
+  clock.us += 90000;
+  bus.loop();
+  HOST_CHECK(!HighFrequencyLoopRequester::is_high_frequency());
+  clock.us += 100000;
+  bus.loop();
+  HOST_CHECK_EQ(canbus.frames_by_id[0x080], 2);
+}
+
+// pending SYNC counter saturates instead of wrapping, dropped SYNCs are counted
+HOST_CHECK_CASE(sync_pending_saturation) {
+  VirtualBus bus;
+  SyncTestNode node(1);
+  node.setup();
+
+  uint32_t sync_count = node.sync_count;
+  for (int i = 0; i < 300; i++)
+    node.sync_received();
+  node.process_sync();
+  HOST_CHECK_EQ(node.sync_count - sync_count, 255);
+  HOST_CHECK_EQ(node.bus_stats.sync_missed, 45);
+
+  node.sync_received();
+  node.process_sync();
+  HOST_CHECK_EQ(node.sync_count - sync_count, 256);
+  HOST_CHECK_EQ(node.bus_stats.sync_missed, 45);
+}
+
+// synchronous TPDO is sent once per N-th SYNC, both for external SYNC and for SYNC produced by the node
+HOST_CHECK_CASE(sync_tpdo_once_per_period) {
+  VirtualBus bus;
+  CountingCanbus canbus;
+  FakeClock clock;
+  TestNode node(1), master(2);
+  node.set_canbus(&canbus);
+  node.set_clock(&clock);
+  TestEntity entity(1, {0, false, 3});
+  node.entities.push_back(&entity);
+  node.setup();
+  master.setup();
+
+  // TPDO service of canopen-stack sees event driven TPDO, SYNC period is applied by the component
+  uint8_t type = 0;
+  HOST_CHECK(COObjRdValue(node.od.find(CO_DEV(0x1800, 2)), node.node, &type, 1) == CO_ERR_NONE);
+  HOST_CHECK_EQ(type, 254);
+
+  for (int i = 0; i < 9; i++) {
+    master.send({0x080, {}, 0});
+    bus.loop();
+  }
+  HOST_CHECK_EQ(canbus.frames_by_id[0x181], 3);
+  HOST_CHECK_EQ(node.tpdo_sent[0], 3);
+
+  node.set_sync_producer(10);
+  for (int i = 0; i < 9; i++) {
+    clock.us += 10000;
+    bus.loop();
+  }
+  HOST_CHECK_EQ(canbus.frames_by_id[0x080], 9);
+  HOST_CHECK_EQ(canbus.frames_by_id[0x181], 6);
+}
+
+}  // namespace host_checks
+}  // namespace canopen
+}  // namespace esphome
@@ -0,0 +1,91 @@
+#pragma once
+// TPDO bookkeeping: sent frame counters with remapped COB-IDs, inhibit time and event timer
+#include "host_checks.h"
+
+namespace esphome {
+namespace canopen {
+namespace host_checks {
+
+class TpdoTestNode : public TestNode {
+ public:
+  using TestNode::TestNode;
+  using CanopenComponent::tpdo_suppressed;
+};
+
+HOST_CHECK_CASE(tpdo_sent_remapped_cob_id) {
+  VirtualBus bus;
+  CountingCanbus canbus;
+  TestNode node(1);
+  node.set_canbus(&canbus);
+  uint32_t state = 0;
+  TPDO tpdo0 = {0, true}, tpdo1 = {1, true};
+  node.od_add_state(1, CO_TUNSIGNED32, &state, 4, tpdo0);
+  node.od_add_state(2, CO_TUNSIGNED32, &state, 4, tpdo1);
+  node.setup();
+  // TPDO 0 moved from default 0x181 to 0x1C1 (node id is added on read)
+  node.od.add_update(CO_KEY(0x1800, 1, CO_OBJ_DN__R_), CO_TUNSIGNED32, (CO_DATA) 0x1C0);
+
+  node.trig_tpdo(0);
+  node.trig_tpdo(1);
+  HOST_CHECK_EQ(canbus.frames_by_id[0x1C1], 1);
+  HOST_CHECK_EQ(canbus.frames_by_id[0x281], 1);
+  HOST_CHECK_EQ(node.tpdo_sent[0], 1);
+  HOST_CHECK_EQ(node.tpdo_sent[1], 1);
+
+  // default COB-ID of TPDO 0 is no longer a TPDO of this node
+  node.send({0x181, {0x01}, 1});
+  HOST_CHECK_EQ(node.tpdo_sent[0], 1);
+}
+
+// inhibit time / event timer from yaml are exposed in 0x1800 + N:03 / :05 and applied by canopen-stack
+HOST_CHECK_CASE(tpdo_inhibit_time_event_timer) {
+  VirtualBus bus;
+  CountingCanbus canbus;
+  FakeClock clock;
+  TpdoTestNode node(1);
+  node.set_canbus(&canbus);
+  node.set_clock(&clock);
+  TPDO tpdo = {0, false};
+  tpdo.inhibit_time = 100;  // 10ms
+  tpdo.event_timer = 100;   // 100ms
+  TestEntity entity(1, tpdo);
+  node.entities.push_back(&entity);
+  node.setup();
+
+  for (uint8_t sub : {3, 5}) {
+    auto obj = node.od.find(CO_DEV(0x1800, sub));
+    uint16_t value = 0;
+    HOST_CHECK(obj && (obj->Key & CO_OBJ_____RW) == CO_OBJ_____RW);
+    HOST_CHECK(obj && COObjRdValue(obj, node.node, &value, 2) == CO_ERR_NONE);
+    HOST_CHECK_EQ(value, 100);
+  }
+
+  entity.publish(&node, 1);
+  bus.loop();
+  HOST_CHECK_EQ(canbus.frames_by_id[0x181], 1);
+
+  // three changes within inhibit window are sent as single frame when it ends
+  for (uint32_t i = 2; i <= 4; i++) {
+    clock.us += 2000;
+    entity.publish(&node, i);
+    bus.loop();
+  }
+  HOST_CHECK_EQ(canbus.frames_by_id[0x181], 1);
+  HOST_CHECK_EQ(node.tpdo_suppressed[0], 2);
+  clock.us += 4000;
+  bus.loop();
+  HOST_CHECK_EQ(canbus.frames_by_id[0x181], 2);
+
+  // unchanged value is resent by event timer, once per 100ms
+  for (int i = 0; i < 1000; i++) {
+    clock.us += 1000;
+    bus.loop();
+  }
+  HOST_CHECK_EQ(canbus.frames_by_id[0x181], 12);
+  HOST_CHECK_EQ(node.tpdo_sent[0], 12);
+  HOST_CHECK_EQ(node.tpdo_suppressed[0], 2);
+}
+
+}  // namespace host_checks
+}  // namespace canopen
+}  // namespace esphome